@@ -0,0 +1,1164 @@
+#include "benchmark.h"
+#include "concurent_map.h"
+#include "concurrent_search_server.h"
+#include "instrumentation.h"
+#include "paginator.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "request_statistics.h"
+#include "posting_list.h"
+#include "search_server.h"
+#include "synthetic_corpus.h"
+#include "tokenizer.h"
+
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+template <typename Function>
+double MeasureSeconds(Function function) {
+    const auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Word ids skewed towards small values, so that low ids behave like common words
+vector<vector<int>> GenerateCorpus(mt19937& generator, int document_count, int vocabulary_size, int min_length, int max_length) {
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    uniform_int_distribution<int> document_length(min_length, max_length);
+    vector<vector<int>> documents(document_count);
+    for (auto& words : documents) {
+        words.resize(document_length(generator));
+        for (int& word : words) {
+            word = static_cast<int>(pow(unit(generator), 3.0) * vocabulary_size);
+        }
+    }
+    return documents;
+}
+
+// Splits operation_count random increments over thread_count threads
+template <typename Increment>
+double MeasureContention(int thread_count, int operation_count, int key_count, Increment increment) {
+    return MeasureSeconds([&] {
+        vector<thread> threads;
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                mt19937 generator(t);
+                uniform_int_distribution<int> key(0, key_count - 1);
+                for (int i = t; i < operation_count; i += thread_count) {
+                    increment(key(generator));
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+    });
+}
+
+// Prints median, 99th percentile and maximum of the latencies, in milliseconds
+void PrintLatencies(ostream& out, vector<double> seconds) {
+    sort(seconds.begin(), seconds.end());
+    const auto percentile = [&seconds](double fraction) {
+        return 1e3 * seconds[min(seconds.size() - 1, static_cast<size_t>(fraction * seconds.size()))];
+    };
+    out << "p50 "s << percentile(0.5) << " ms, p99 "s << percentile(0.99) << " ms, max "s << percentile(1.0) << " ms"s;
+}
+
+string JoinWords(const vector<int>& words) {
+    string text;
+    for (const int word : words) {
+        text += "w"s + to_string(word) + ' ';
+    }
+    return text;
+}
+
+// Largest resident set of the process so far
+size_t GetPeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Time of each of count calls of operation(index)
+template <typename Operation>
+vector<double> MeasureEach(size_t count, Operation operation) {
+    vector<double> seconds(count);
+    for (size_t i = 0; i < count; ++i) {
+        seconds[i] = MeasureSeconds([&] {
+            operation(i);
+        });
+    }
+    return seconds;
+}
+
+// One JSON object per line. Throughput counts the measured calls only; result_count tells
+// whether two runs did the same work
+void PrintSuiteResult(ostream& out, string_view name, vector<double> seconds, size_t result_count) {
+    sort(seconds.begin(), seconds.end());
+    const double total_seconds = accumulate(seconds.begin(), seconds.end(), 0.0);
+    const auto percentile = [&seconds](double fraction) {
+        return seconds.empty() ? 0.0 : 1e6 * seconds[min(seconds.size() - 1, static_cast<size_t>(fraction * seconds.size()))];
+    };
+    out << "{\"benchmark\":\""s << name << "\",\"operations\":"s << seconds.size()
+        << ",\"ops_per_second\":"s << (total_seconds > 0.0 ? seconds.size() / total_seconds : 0.0)
+        << ",\"p50_us\":"s << percentile(0.5) << ",\"p90_us\":"s << percentile(0.9)
+        << ",\"p99_us\":"s << percentile(0.99) << ",\"max_us\":"s << percentile(1.0)
+        << ",\"results\":"s << result_count << ",\"peak_rss_bytes\":"s << GetPeakResidentBytes() << "}"s << endl;
+}
+
+}
+
+void BenchmarkPostingScan(ostream& out, int posting_count, int repeat_count) {
+    mt19937 generator(posting_count);
+    uniform_real_distribution<double> term_freq(0.0, 1.0);
+
+    map<int, double> tree_postings;
+    PostingList flat_postings;
+    for (int i = 0; i < posting_count; ++i) {
+        const double freq = term_freq(generator);
+        tree_postings.emplace(i * 3, freq);
+        flat_postings.Add(i * 3, freq);
+    }
+    flat_postings.Flush();
+
+    double tree_sum = 0.0;
+    const double tree_seconds = MeasureSeconds([&] {
+        for (int r = 0; r < repeat_count; ++r) {
+            for (const auto& [document_id, freq] : tree_postings) {
+                tree_sum += document_id * freq;
+            }
+        }
+    });
+
+    double flat_sum = 0.0;
+    const double flat_seconds = MeasureSeconds([&] {
+        for (int r = 0; r < repeat_count; ++r) {
+            flat_postings.ForEach([&flat_sum](int document_id, double freq) {
+                flat_sum += document_id * freq;
+            });
+        }
+    });
+
+    const double scanned = 1e-6 * posting_count * repeat_count;
+    out << "posting scan, "s << posting_count << " postings x "s << repeat_count << endl
+        << "  std::map:    "s << scanned / tree_seconds << " Mpostings/s"s << endl
+        << "  PostingList: "s << scanned / flat_seconds << " Mpostings/s"s << endl;
+    if (tree_sum != flat_sum) {
+        out << "  checksum mismatch: "s << tree_sum << " vs "s << flat_sum << endl;
+    }
+}
+
+void BenchmarkPostingFormats(ostream& out, int document_count, int query_count) {
+    const int vocabulary_size = 50'000;
+    mt19937 generator(document_count);
+    const vector<vector<int>> documents = GenerateCorpus(generator, document_count, vocabulary_size, 20, 60);
+    const vector<vector<int>> queries = GenerateCorpus(generator, query_count, vocabulary_size / 10, 3, 3);
+
+    out << "posting formats, "s << document_count << " documents, "s << query_count << " queries"s << endl;
+    for (const PostingFormat format : { PostingFormat::FLAT, PostingFormat::COMPRESSED }) {
+        vector<PostingList> postings(vocabulary_size, PostingList(format));
+        for (int document_id = 0; document_id < document_count; ++document_id) {
+            map<int, double> word_freqs;
+            for (const int word : documents[document_id]) {
+                word_freqs[word] += 1.0 / documents[document_id].size();
+            }
+            for (const auto& [word, term_freq] : word_freqs) {
+                postings[word].Add(document_id, term_freq);
+                postings[word].Flush();
+            }
+        }
+        size_t posting_count = 0;
+        size_t memory_usage = 0;
+        for (const PostingList& list : postings) {
+            posting_count += list.size();
+            memory_usage += list.GetMemoryUsage();
+        }
+
+        double checksum = 0.0;
+        const double scan_seconds = MeasureSeconds([&] {
+            for (const PostingList& list : postings) {
+                list.ForEach([&checksum](int, double term_freq) {
+                    checksum += term_freq;
+                });
+            }
+        });
+
+        SearchServer search_server(""s, format);
+        for (int document_id = 0; document_id < document_count; ++document_id) {
+            search_server.AddDocument(document_id, JoinWords(documents[document_id]), DocumentStatus::ACTUAL, { document_id % 10 });
+        }
+        size_t result_count = 0;
+        const double query_seconds = MeasureSeconds([&] {
+            for (const auto& query : queries) {
+                result_count += search_server.FindTopDocuments(JoinWords(query)).size();
+            }
+        });
+
+        out << (format == PostingFormat::FLAT ? "  FLAT:       "s : "  COMPRESSED: "s)
+            << 1.0 * memory_usage / posting_count << " bytes/posting, "s
+            << 1e-6 * posting_count / scan_seconds << " Mpostings/s scan, "s
+            << query_count / query_seconds << " queries/s"s
+            << " (checksum "s << checksum << ", "s << result_count << " results)"s << endl;
+    }
+}
+
+void BenchmarkConcurrentMap(ostream& out, int max_thread_count, int operation_count) {
+    const int key_count = 100'000;
+    out << "concurrent map, "s << operation_count << " increments over "s << key_count << " keys"s << endl;
+    for (int thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+        ConcurrentMap<int, int> striped_map(static_cast<size_t>(thread_count) * 16);
+        const double striped_seconds = MeasureContention(thread_count, operation_count, key_count, [&striped_map](int key) {
+            striped_map.Update(key, [](int& value) {
+                ++value;
+            });
+        });
+
+        mutex global_mutex;
+        map<int, int> global_map;
+        const double global_seconds = MeasureContention(thread_count, operation_count, key_count, [&](int key) {
+            lock_guard guard(global_mutex);
+            ++global_map[key];
+        });
+
+        long long striped_sum = 0;
+        for (const auto& [key, value] : striped_map.BuildSortedVector()) {
+            striped_sum += value;
+        }
+        out << "  "s << thread_count << " threads: ConcurrentMap "s << 1e-6 * operation_count / striped_seconds
+            << " Mops/s, mutex + std::map "s << 1e-6 * operation_count / global_seconds << " Mops/s"s;
+        if (striped_sum != operation_count) {
+            out << " (lost updates: "s << operation_count - striped_sum << ")"s;
+        }
+        out << endl;
+    }
+}
+
+void BenchmarkIndexing(ostream& out, int document_count) {
+    mt19937 generator(document_count);
+    const vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 50'000, 20, 60);
+    vector<string> texts;
+    texts.reserve(corpus.size());
+    for (const auto& words : corpus) {
+        texts.push_back(JoinWords(words));
+    }
+
+    out << "indexing, "s << document_count << " documents"s << endl;
+    for (const PostingFormat format : { PostingFormat::FLAT, PostingFormat::COMPRESSED }) {
+        SearchServer one_by_one(""s, format);
+        const double one_by_one_seconds = MeasureSeconds([&] {
+            for (int document_id = 0; document_id < document_count; ++document_id) {
+                one_by_one.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 10 });
+            }
+        });
+
+        vector<DocumentInput> documents;
+        documents.reserve(texts.size());
+        for (int document_id = 0; document_id < document_count; ++document_id) {
+            documents.push_back({ document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 10 } });
+        }
+        SearchServer batch(""s, format);
+        const double batch_seconds = MeasureSeconds([&] {
+            batch.AddDocuments(documents);
+        });
+
+        out << (format == PostingFormat::FLAT ? "  FLAT:       "s : "  COMPRESSED: "s)
+            << "AddDocument "s << one_by_one_seconds << " s, AddDocuments "s << batch_seconds << " s"s << endl;
+    }
+}
+
+void BenchmarkSnapshot(ostream& out, int document_count, int query_count) {
+    mt19937 generator(document_count);
+    const vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 50'000, 20, 60);
+    const vector<vector<int>> queries = GenerateCorpus(generator, query_count, 50'000, 2, 2);
+    vector<string> texts;
+    vector<DocumentInput> documents;
+    texts.reserve(corpus.size());
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        texts.push_back(JoinWords(corpus[document_id]));
+        documents.push_back({ document_id, texts.back(), DocumentStatus::ACTUAL, { document_id % 10 } });
+    }
+    const string path = (filesystem::temp_directory_path() / "search_server_benchmark.snapshot"s).string();
+
+    out << "snapshot, "s << document_count << " documents, "s << query_count << " queries"s << endl;
+    for (const PostingFormat format : { PostingFormat::FLAT, PostingFormat::COMPRESSED }) {
+        SearchServer indexed(""s, format);
+        const double index_seconds = MeasureSeconds([&] {
+            indexed.AddDocuments(documents);
+        });
+        const double save_seconds = MeasureSeconds([&] {
+            indexed.SaveSnapshot(path);
+        });
+        optional<SearchServer> loaded;
+        const double load_seconds = MeasureSeconds([&] {
+            loaded.emplace(SearchServer::LoadSnapshot(path));
+        });
+
+        size_t indexed_results = 0;
+        const double indexed_seconds = MeasureSeconds([&] {
+            for (const auto& query : queries) {
+                indexed_results += indexed.FindTopDocuments(JoinWords(query)).size();
+            }
+        });
+        size_t loaded_results = 0;
+        const double loaded_seconds = MeasureSeconds([&] {
+            for (const auto& query : queries) {
+                loaded_results += loaded->FindTopDocuments(JoinWords(query)).size();
+            }
+        });
+
+        out << (format == PostingFormat::FLAT ? "  FLAT:       "s : "  COMPRESSED: "s)
+            << filesystem::file_size(path) / 1'000'000 << " MB, index "s << index_seconds << " s, save "s << save_seconds
+            << " s, load "s << load_seconds << " s; "s << query_count / indexed_seconds << " queries/s indexed, "s
+            << query_count / loaded_seconds << " queries/s loaded"s;
+        if (indexed_results != loaded_results) {
+            out << " (result count mismatch: "s << indexed_results << " vs "s << loaded_results << ")"s;
+        }
+        out << endl;
+    }
+    filesystem::remove(path);
+}
+
+void BenchmarkResultCache(ostream& out, int document_count, int query_count) {
+    mt19937 generator(document_count);
+    const vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 50'000, 20, 60);
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        search_server.AddDocument(document_id, JoinWords(corpus[document_id]), DocumentStatus::ACTUAL, { document_id % 10 });
+    }
+
+    // A few thousand distinct queries, the popular ones asked far more often
+    const vector<vector<int>> distinct_queries = GenerateCorpus(generator, 5'000, 5'000, 2, 4);
+    const vector<vector<int>> picks = GenerateCorpus(generator, 1, static_cast<int>(distinct_queries.size()), query_count, query_count);
+    vector<string> queries;
+    for (const int pick : picks.front()) {
+        queries.push_back(JoinWords(distinct_queries[pick]));
+    }
+
+    out << "result cache, "s << document_count << " documents, "s << query_count << " queries"s << endl;
+    for (const size_t capacity : { size_t{ 0 }, size_t{ 1'000 }, size_t{ 10'000 } }) {
+        search_server.SetResultCacheCapacity(capacity);
+        size_t result_count = 0;
+        const double seconds = MeasureSeconds([&] {
+            for (const string& query : queries) {
+                result_count += search_server.FindTopDocuments(query).size();
+            }
+        });
+        const QueryResultCache::Statistics statistics = search_server.GetResultCacheStatistics();
+        out << "  capacity "s << capacity << ": "s << query_count / seconds << " queries/s, "s
+            << statistics.hits << " hits, "s << statistics.misses << " misses, "s << statistics.evictions << " evictions"s
+            << " ("s << result_count << " results)"s << endl;
+    }
+}
+
+void BenchmarkQueryBatch(ostream& out, int document_count, int query_count) {
+    mt19937 generator(document_count);
+    const vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 50'000, 20, 60);
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        search_server.AddDocument(document_id, JoinWords(corpus[document_id]), DocumentStatus::ACTUAL, { document_id % 10 });
+    }
+
+    // Every tenth query is made of common words and scores a large part of the corpus
+    vector<string> queries;
+    const vector<vector<int>> short_queries = GenerateCorpus(generator, query_count, 50'000, 2, 2);
+    const vector<vector<int>> long_queries = GenerateCorpus(generator, query_count, 50, 8, 8);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(JoinWords(i % 10 == 0 ? long_queries[i] : short_queries[i]));
+    }
+
+    out << "query batch, "s << document_count << " documents, "s << query_count << " queries"s << endl;
+    vector<double> latencies(queries.size());
+    auto start = chrono::steady_clock::now();
+    vector<vector<Document>> transformed(queries.size());
+    transform(execution::par, queries.begin(), queries.end(), transformed.begin(), [&search_server](const string& query) {
+        return search_server.FindTopDocuments(query);
+    });
+    // Nothing is handed out before the whole batch is done
+    fill(latencies.begin(), latencies.end(), chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    out << "  transform(par):  "s;
+    PrintLatencies(out, latencies);
+    out << endl;
+
+    ThreadPool& pool = GetDefaultThreadPool();
+    start = chrono::steady_clock::now();
+    ProcessQueries(pool, search_server, queries, [&](size_t query_index, vector<Document>) {
+        latencies[query_index] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    });
+    out << "  ProcessQueries:  "s;
+    PrintLatencies(out, latencies);
+    out << " ("s << pool.GetThreadCount() << " workers)"s << endl;
+}
+
+void BenchmarkJoinedResults(ostream& out, int document_count, int query_count) {
+    mt19937 generator(document_count);
+    const vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 50'000, 20, 60);
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        search_server.AddDocument(document_id, JoinWords(corpus[document_id]), DocumentStatus::ACTUAL, { document_id % 10 });
+    }
+    vector<string> queries;
+    for (const vector<int>& query : GenerateCorpus(generator, query_count, 50'000, 2, 2)) {
+        queries.push_back(JoinWords(query));
+    }
+
+    out << "joined results, "s << document_count << " documents, "s << query_count << " queries"s << endl;
+    size_t list_size = 0;
+    const double list_seconds = MeasureSeconds([&] {
+        // The previous ProcessQueriesJoined: a vector per query, spliced node by node into a list
+        list<Document> joined;
+        for (vector<Document>& documents : ProcessQueries(search_server, queries)) {
+            joined.insert(joined.end(), documents.begin(), documents.end());
+        }
+        for (const Document& document : joined) {
+            list_size += document.id >= 0;
+        }
+    });
+    size_t flat_size = 0;
+    const double flat_seconds = MeasureSeconds([&] {
+        for (const Document& document : ProcessQueriesJoined(search_server, queries)) {
+            flat_size += document.id >= 0;
+        }
+    });
+    out << "  list<Document>:     "s << list_seconds * 1000 << " ms, "s << list_size << " documents"s << endl;
+    out << "  JoinedQueryResults: "s << flat_seconds * 1000 << " ms, "s << flat_size << " documents"s << endl;
+}
+
+void BenchmarkDeduplication(ostream& out, int document_count, int pairwise_document_count) {
+    mt19937 generator(document_count);
+    vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 200'000, 4, 12);
+    // Every tenth document repeats the words of an earlier one in another order
+    for (int document_id = 10; document_id < document_count; document_id += 10) {
+        corpus[document_id] = corpus[uniform_int_distribution<int>(0, document_id - 1)(generator)];
+        shuffle(corpus[document_id].begin(), corpus[document_id].end(), generator);
+    }
+    const auto build = [&corpus](int count) {
+        SearchServer search_server(""s);
+        vector<string> texts(count);
+        vector<DocumentInput> batch(count);
+        for (int document_id = 0; document_id < count; ++document_id) {
+            texts[document_id] = JoinWords(corpus[document_id]);
+            batch[document_id] = { document_id, texts[document_id], DocumentStatus::ACTUAL, {} };
+        }
+        search_server.AddDocuments(batch);
+        return search_server;
+    };
+
+    out << "deduplication, "s << document_count << " documents"s << endl;
+    {
+        // The previous RemoveDuplicates compared word maps of every pair of documents
+        const SearchServer search_server = build(pairwise_document_count);
+        size_t duplicate_count = 0;
+        const double seconds = MeasureSeconds([&] {
+            for (auto it = search_server.begin(); it != search_server.end(); ++it) {
+                const map<string_view, double> words = search_server.GetWordFrequencyMap(*it);
+                for (auto jt = next(it); jt != search_server.end(); ++jt) {
+                    if (IsDuplicate(words, search_server.GetWordFrequencyMap(*jt))) {
+                        ++duplicate_count;
+                        break;
+                    }
+                }
+            }
+        });
+        out << "  pairwise, "s << pairwise_document_count << " documents: "s << seconds * 1000 << " ms"s << endl;
+    }
+    SearchServer search_server = build(document_count);
+    size_t duplicate_count = 0;
+    const double find_seconds = MeasureSeconds([&] {
+        duplicate_count = FindDuplicates(search_server).size();
+    });
+    ostringstream sink;
+    streambuf* const cout_buffer = cout.rdbuf(sink.rdbuf());
+    const double remove_seconds = MeasureSeconds([&] {
+        RemoveDuplicates(search_server);
+    });
+    cout.rdbuf(cout_buffer);
+    out << "  FindDuplicates:   "s << find_seconds * 1000 << " ms, "s << duplicate_count << " duplicates"s << endl;
+    out << "  RemoveDuplicates: "s << remove_seconds * 1000 << " ms, "s << search_server.GetDocumentCount() << " documents left"s << endl;
+}
+
+void BenchmarkNearDuplicates(ostream& out, int document_count) {
+    mt19937 generator(document_count);
+    vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 200'000, 20, 60);
+    // Every tenth document is an earlier one with about a tenth of its words replaced
+    uniform_int_distribution<int> rare_word(200'000, 400'000);
+    int planted_count = 0;
+    for (int document_id = 10; document_id < document_count; document_id += 10) {
+        corpus[document_id] = corpus[uniform_int_distribution<int>(0, document_id - 1)(generator)];
+        for (int& word : corpus[document_id]) {
+            if (generator() % 10 == 0) {
+                word = rare_word(generator);
+            }
+        }
+        ++planted_count;
+    }
+    vector<string> texts(document_count);
+    vector<DocumentInput> batch(document_count);
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        texts[document_id] = JoinWords(corpus[document_id]);
+        batch[document_id] = { document_id, texts[document_id], DocumentStatus::ACTUAL, {} };
+    }
+
+    out << "near duplicates, "s << document_count << " documents, "s << planted_count << " planted"s << endl;
+    const double plain_seconds = MeasureSeconds([&batch] {
+        SearchServer search_server(""s);
+        search_server.AddDocuments(batch);
+    });
+    SearchServer search_server(""s);
+    search_server.SetNearDuplicateDetection(true);
+    const double signed_seconds = MeasureSeconds([&] {
+        search_server.AddDocuments(batch);
+    });
+    out << "  AddDocuments:        "s << plain_seconds * 1000 << " ms, with signatures "s << signed_seconds * 1000 << " ms"s << endl;
+    const double enable_seconds = MeasureSeconds([&] {
+        search_server.SetNearDuplicateDetection(true);
+    });
+    out << "  signing all at once: "s << enable_seconds * 1000 << " ms"s << endl;
+    for (const double threshold : { 0.5, 0.7, 0.9 }) {
+        size_t found_count = 0;
+        const double seconds = MeasureSeconds([&] {
+            for (const NearDuplicateCluster& cluster : FindNearDuplicates(search_server, threshold)) {
+                found_count += cluster.duplicates.size();
+            }
+        });
+        out << "  FindNearDuplicates("s << threshold << "): "s << seconds * 1000 << " ms, "s << found_count << " found"s << endl;
+    }
+}
+
+void BenchmarkTokenizer(ostream& out, int document_count, int repeat_count) {
+    mt19937 generator(document_count);
+    vector<string> texts;
+    size_t byte_count = 0;
+    for (const vector<int>& words : GenerateCorpus(generator, document_count, 50'000, 20, 60)) {
+        texts.push_back(JoinWords(words));
+        byte_count += texts.back().size();
+    }
+    const auto print = [&](const string& name, double seconds, size_t word_count) {
+        out << "  "s << name << byte_count * repeat_count / seconds / (1 << 20) << " MiB/s, "s << word_count << " words"s << endl;
+    };
+
+    out << "tokenizer, "s << document_count << " documents, "s << byte_count / (1 << 20) << " MiB"s << endl;
+    size_t word_count = 0;
+    double seconds = MeasureSeconds([&] {
+        // What AddDocument did before: check the text, split it, then check every word again
+        for (int repeat = 0; repeat < repeat_count; ++repeat) {
+            for (const string& text : texts) {
+                const auto is_valid = [](string_view word) {
+                    return none_of(word.begin(), word.end(), [](char c) {
+                        return c >= '\0' && c < ' ';
+                    });
+                };
+                if (!is_valid(text)) {
+                    continue;
+                }
+                string_view rest = text;
+                rest.remove_prefix(min(rest.find_first_not_of(' '), rest.size()));
+                while (!rest.empty()) {
+                    const size_t space = rest.find(' ');
+                    word_count += is_valid(rest.substr(0, space));
+                    rest.remove_prefix(min(rest.find_first_not_of(' ', space), rest.size()));
+                }
+            }
+        }
+    });
+    print("validate + split + validate: "s, seconds, word_count);
+    vector<string_view> words;
+    for (const auto& [isa, name] : { pair{ TokenizerIsa::SCALAR, "scalar"s }, pair{ TokenizerIsa::SSE2, "SSE2"s }, pair{ TokenizerIsa::AVX2, "AVX2"s } }) {
+        if (isa > GetTokenizerIsa()) {
+            continue;
+        }
+        word_count = 0;
+        seconds = MeasureSeconds([&] {
+            for (int repeat = 0; repeat < repeat_count; ++repeat) {
+                for (const string& text : texts) {
+                    if (TokenizeWords(text, words, isa)) {
+                        word_count += words.size();
+                    }
+                }
+            }
+        });
+        print("TokenizeWords, "s + name + ": "s, seconds, word_count);
+    }
+}
+
+void BenchmarkIngestion(ostream& out, int document_count, int ingested_count, int batch_size) {
+    mt19937 generator(document_count);
+    vector<string> texts;
+    for (const vector<int>& words : GenerateCorpus(generator, document_count + ingested_count, 50'000, 20, 60)) {
+        texts.push_back(JoinWords(words));
+    }
+    vector<string> queries;
+    for (const vector<int>& words : GenerateCorpus(generator, 1'000, 50'000, 2, 3)) {
+        queries.push_back(JoinWords(words));
+    }
+    const auto make_batch = [&texts](int first_id, int count) {
+        vector<DocumentInput> documents;
+        for (int document_id = first_id; document_id < first_id + count; ++document_id) {
+            documents.push_back({ document_id, texts[document_id], DocumentStatus::ACTUAL, {} });
+        }
+        return documents;
+    };
+    const auto make_server = [&] {
+        SearchServer search_server(""s);
+        search_server.AddDocuments(make_batch(0, document_count));
+        return search_server;
+    };
+    // Batch i adds the next batch_size documents and removes the oldest ones, keeping the size steady
+    const auto write_batch = [&](SearchServer& search_server, int batch) {
+        search_server.AddDocuments(make_batch(document_count + batch * batch_size, batch_size));
+        vector<int> removed_ids(batch_size);
+        iota(removed_ids.begin(), removed_ids.end(), batch * batch_size);
+        search_server.RemoveDocuments(removed_ids);
+    };
+    // Queries on this thread until the writes on another one are done
+    const auto measure = [&](const string& name, auto search, auto write) {
+        atomic<bool> done = false;
+        double write_seconds = 0.0;
+        thread writer([&] {
+            write_seconds = MeasureSeconds([&] {
+                for (int batch = 0; batch < ingested_count / batch_size; ++batch) {
+                    write(batch);
+                }
+            });
+            done = true;
+        });
+        vector<double> latencies;
+        for (size_t i = 0; !done; ++i) {
+            const string& query = queries[i % queries.size()];
+            latencies.push_back(MeasureSeconds([&] {
+                search(query);
+            }));
+        }
+        writer.join();
+        out << "  "s << name;
+        PrintLatencies(out, latencies);
+        out << ", "s << ingested_count / write_seconds << " documents/s ingested"s << endl;
+    };
+
+    out << "ingestion, "s << document_count << " documents, "s << ingested_count << " replaced in batches of "s << batch_size << endl;
+    {
+        const SearchServer search_server = make_server();
+        vector<double> latencies;
+        for (const string& query : queries) {
+            latencies.push_back(MeasureSeconds([&] {
+                search_server.FindTopDocuments(query);
+            }));
+        }
+        out << "  no writes:    "s;
+        PrintLatencies(out, latencies);
+        out << endl;
+    }
+    {
+        SearchServer search_server = make_server();
+        mutex server_mutex;
+        measure("global mutex: "s, [&](const string& query) {
+            lock_guard lock(server_mutex);
+            search_server.FindTopDocuments(query);
+        }, [&](int batch) {
+            lock_guard lock(server_mutex);
+            write_batch(search_server, batch);
+        });
+    }
+    {
+        ConcurrentSearchServer search_server(make_server());
+        measure("snapshots:    "s, [&](const string& query) {
+            search_server.GetSnapshot()->FindTopDocuments(query);
+        }, [&](int batch) {
+            search_server.Modify([&](SearchServer& version) {
+                write_batch(version, batch);
+            });
+        });
+    }
+}
+
+void BenchmarkRequestStatistics(ostream& out, int max_thread_count, int operation_count) {
+    mt19937 generator(operation_count);
+    vector<string> queries;
+    for (const vector<int>& words : GenerateCorpus(generator, 1'000, 50'000, 2, 4)) {
+        queries.push_back(JoinWords(words));
+    }
+    vector<vector<Document>> results(MAX_RESULT_DOCUMENT_COUNT + 1);
+    for (size_t count = 0; count < results.size(); ++count) {
+        results[count].resize(count);
+    }
+
+    out << "request statistics, "s << operation_count << " requests"s << endl;
+    // What RequestQueue did before: a copy of each of the last 1440 queries and its results
+    int no_result_count = 0;
+    double seconds = MeasureSeconds([&] {
+        deque<pair<string, vector<Document>>> requests;
+        for (int i = 0; i < operation_count; ++i) {
+            const vector<Document>& documents = results[i % results.size()];
+            no_result_count += documents.empty();
+            requests.push_back({ queries[i % queries.size()], documents });
+            if (requests.size() > 1440) {
+                no_result_count -= requests.front().second.empty();
+                requests.pop_front();
+            }
+        }
+    });
+    out << "  deque of the last 1440 requests: "s << seconds * 1e9 / operation_count << " ns/request"s << endl;
+
+    // Callers read the clock for the latency anyway, and pass the time along
+    RequestStatistics statistics(1440);
+    const auto now = RequestStatistics::Clock::now();
+    for (int thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+        seconds = MeasureContention(thread_count, operation_count, 1 << 16, [&](int key) {
+            statistics.Record(key % results.size(), chrono::microseconds(key), now);
+        });
+        out << "  Record, "s << thread_count << " threads: "s << seconds * 1e9 / operation_count << " ns/request"s << endl;
+    }
+    RequestStatistics::Summary summary;
+    seconds = MeasureSeconds([&] {
+        summary = statistics.GetSummary(chrono::minutes(1440), now);
+    });
+    out << "  GetSummary over a day: "s << seconds * 1000 << " ms, "s << summary.request_count << " requests, p99 "s
+        << summary.latencies.GetPercentile(0.99).count() << " us; ring of "s
+        << statistics.GetMinuteCount() << " minutes"s << endl;
+}
+
+void BenchmarkInstrumentation(ostream& out, int document_count, int query_count) {
+    mt19937 generator(document_count);
+    const vector<vector<int>> corpus = GenerateCorpus(generator, document_count, 50'000, 20, 60);
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        search_server.AddDocument(document_id, JoinWords(corpus[document_id]), DocumentStatus::ACTUAL, { document_id % 10 });
+    }
+    vector<string> queries;
+    for (const auto& words : GenerateCorpus(generator, query_count, 50'000, 2, 6)) {
+        queries.push_back(JoinWords(words));
+    }
+    // A third of the documents fail the predicate
+    const auto predicate = [](int document_id, DocumentStatus, int) {
+        return document_id % 3 != 0;
+    };
+
+    ResetInstrumentationTotals();
+    size_t result_count = 0;
+    const double seconds = MeasureSeconds([&] {
+        for (const string& query : queries) {
+            result_count += search_server.FindTopDocuments(query, predicate).size();
+        }
+    });
+    out << "instrumentation "s << (INSTRUMENTATION_ENABLED ? "on"s : "off"s) << ", "s << document_count << " documents: "s
+        << query_count / seconds << " queries/s ("s << result_count << " results)"s << endl;
+    if (!INSTRUMENTATION_ENABLED) {
+        return;
+    }
+    const InstrumentationTotals totals = GetInstrumentationTotals();
+    for (size_t phase = 0; phase < INSTRUMENTED_PHASE_COUNT; ++phase) {
+        out << "  "s << GetPhaseName(static_cast<InstrumentedPhase>(phase)) << ": "s
+            << chrono::duration<double, micro>(totals.trace.phase_times[phase]).count() / totals.call_count << " us/query"s << endl;
+    }
+    for (size_t counter = 0; counter < INSTRUMENTED_COUNTER_COUNT; ++counter) {
+        out << "  "s << GetCounterName(static_cast<InstrumentedCounter>(counter)) << ": "s
+            << static_cast<double>(totals.trace.counters[counter]) / totals.call_count << " per query"s << endl;
+    }
+}
+
+void BenchmarkRetrievalModes(ostream& out, int document_count, int query_count) {
+    SyntheticCorpusOptions options;
+    options.document_count = document_count;
+    options.query_count = query_count;
+    options.minus_word_ratio = 0.0;
+    const SyntheticCorpus corpus = GenerateSyntheticCorpus(options);
+
+    // Two to five of the hundred most frequent words, the queries that pruning helps most
+    mt19937 generator(query_count);
+    uniform_int_distribution<int> query_length(2, 5);
+    uniform_int_distribution<int> common_word(0, 99);
+    vector<string> common_queries(query_count);
+    for (string& query : common_queries) {
+        for (int i = query_length(generator); i > 0; --i) {
+            query += "w"s + to_string(common_word(generator)) + ' ';
+        }
+    }
+    const auto predicate = [](int, DocumentStatus status, int) {
+        return status == DocumentStatus::ACTUAL;
+    };
+
+    out << "retrieval modes, "s << document_count << " documents, "s << query_count << " queries"s << endl;
+    for (const PostingFormat format : { PostingFormat::FLAT, PostingFormat::COMPRESSED }) {
+        SearchServer search_server(corpus.stop_words, format);
+        for (const SyntheticDocument& document : corpus.documents) {
+            search_server.AddDocument(document.document_id, document.text, document.status, document.ratings);
+        }
+        for (const auto& [name, queries] : { pair{ "common words"s, &as_const(common_queries) }, pair{ "corpus queries"s, &corpus.queries } }) {
+            vector<vector<Document>> results[2];
+            double seconds[2];
+            for (const RetrievalMode mode : { RetrievalMode::EXHAUSTIVE, RetrievalMode::MAX_SCORE }) {
+                const size_t index = mode == RetrievalMode::MAX_SCORE;
+                search_server.SetRetrievalMode(mode);
+                seconds[index] = MeasureSeconds([&] {
+                    for (const string& query : *queries) {
+                        results[index].push_back(search_server.FindTopDocuments(query, predicate));
+                    }
+                });
+            }
+            size_t mismatch_count = 0;
+            for (size_t i = 0; i < queries->size(); ++i) {
+                mismatch_count += !equal(results[0][i].begin(), results[0][i].end(), results[1][i].begin(), results[1][i].end(),
+                    [](const Document& lhs, const Document& rhs) {
+                        return lhs.id == rhs.id;
+                    });
+            }
+            out << "  "s << (format == PostingFormat::FLAT ? "flat"s : "compressed"s) << ", "s << name << ": exhaustive "s
+                << queries->size() / seconds[0] << " queries/s, max score "s << queries->size() / seconds[1] << " queries/s ("s
+                << seconds[0] / seconds[1] << "x), "s << mismatch_count << " mismatches"s << endl;
+        }
+    }
+}
+
+void BenchmarkStatusFilter(ostream& out, int document_count, int query_count) {
+    SyntheticCorpusOptions options;
+    options.document_count = document_count;
+    options.query_count = query_count;
+    const SyntheticCorpus corpus = GenerateSyntheticCorpus(options);
+    SearchServer search_server(corpus.stop_words);
+    for (const SyntheticDocument& document : corpus.documents) {
+        search_server.AddDocument(document.document_id, document.text, document.status, document.ratings);
+    }
+    const auto lambda = [](int, DocumentStatus status, int) {
+        return status == DocumentStatus::ACTUAL;
+    };
+
+    out << "status filter, "s << document_count << " documents, "s << query_count << " queries"s << endl;
+    for (const RetrievalMode mode : { RetrievalMode::EXHAUSTIVE, RetrievalMode::MAX_SCORE }) {
+        search_server.SetRetrievalMode(mode);
+        size_t lambda_results = 0;
+        const double lambda_seconds = MeasureSeconds([&] {
+            for (const string& query : corpus.queries) {
+                lambda_results += search_server.FindTopDocuments(query, lambda).size();
+            }
+        });
+        size_t status_results = 0;
+        const double status_seconds = MeasureSeconds([&] {
+            for (const string& query : corpus.queries) {
+                status_results += search_server.FindTopDocuments(query, DocumentStatus::ACTUAL).size();
+            }
+        });
+        out << "  "s << (mode == RetrievalMode::EXHAUSTIVE ? "exhaustive"s : "max score"s) << ": lambda "s
+            << query_count / lambda_seconds << " queries/s, status bitmap "s << query_count / status_seconds << " queries/s ("s
+            << lambda_seconds / status_seconds << "x, "s << lambda_results << " and "s << status_results << " results)"s << endl;
+    }
+}
+
+void BenchmarkPages(ostream& out, int document_count, int query_count, int page_count, int page_size) {
+    SyntheticCorpusOptions options;
+    options.document_count = document_count;
+    options.query_count = query_count;
+    const SyntheticCorpus corpus = GenerateSyntheticCorpus(options);
+    SearchServer search_server(corpus.stop_words);
+    for (const SyntheticDocument& document : corpus.documents) {
+        search_server.AddDocument(document.document_id, document.text, document.status, document.ratings);
+    }
+    const size_t page_limit = static_cast<size_t>(page_size);
+    const size_t document_limit = static_cast<size_t>(page_count) * page_limit;
+
+    size_t paginated_count = 0;
+    const double paginated_seconds = MeasureSeconds([&] {
+        for (const string& query : corpus.queries) {
+            for (int page = 0; page < page_count; ++page) {
+                const vector<Document> documents = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, numeric_limits<size_t>::max());
+                const auto pages = Paginate(documents, page_limit);
+                if (static_cast<size_t>(page) < pages.size()) {
+                    paginated_count += next(pages.begin(), page)->size();
+                }
+            }
+        }
+    });
+    size_t offset_count = 0;
+    const double offset_seconds = MeasureSeconds([&] {
+        for (const string& query : corpus.queries) {
+            for (size_t offset = 0; offset < document_limit; offset += page_limit) {
+                offset_count += search_server.FindDocumentsPage(query, offset, page_limit).documents.size();
+            }
+        }
+    });
+    size_t cursor_count = 0;
+    const double cursor_seconds = MeasureSeconds([&] {
+        for (const string& query : corpus.queries) {
+            DocumentPage page = search_server.FindDocumentsPage(query, 0, page_limit);
+            cursor_count += page.documents.size();
+            for (int i = 1; i < page_count; ++i) {
+                page = search_server.FindDocumentsPage(page.next, page_limit);
+                cursor_count += page.documents.size();
+            }
+        }
+    });
+    // Following the cursors of a few queries to the end must give every match once, in the
+    // order FindTopDocuments ranks them in
+    const size_t checked_query_count = min<size_t>(corpus.queries.size(), 10);
+    size_t mismatch_count = 0;
+    for (size_t i = 0; i < checked_query_count; ++i) {
+        const string& query = corpus.queries[i];
+        const vector<Document> expected = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, numeric_limits<size_t>::max());
+        vector<Document> paged;
+        DocumentPage page = search_server.FindDocumentsPage(query, 0, page_limit);
+        paged.insert(paged.end(), page.documents.begin(), page.documents.end());
+        while (!page.next.IsEnd() && paged.size() <= expected.size()) {
+            page = search_server.FindDocumentsPage(page.next, page_limit);
+            paged.insert(paged.end(), page.documents.begin(), page.documents.end());
+        }
+        mismatch_count += !equal(expected.begin(), expected.end(), paged.begin(), paged.end(), [](const Document& lhs, const Document& rhs) {
+            return lhs.id == rhs.id;
+        });
+    }
+    const double request_count = static_cast<double>(query_count) * page_count;
+    out << "pages, "s << document_count << " documents, "s << query_count << " queries, "s << page_count << " pages of "s << page_size
+        << ": all matches paginated "s << request_count / paginated_seconds << " pages/s ("s << paginated_count << " documents), offsets "s
+        << request_count / offset_seconds << " pages/s ("s << offset_count << "), cursors "s << request_count / cursor_seconds
+        << " pages/s ("s << cursor_count << "), "s << mismatch_count << " of "s << checked_query_count
+        << " queries paginated to the end differ from the ranking"s << endl;
+}
+
+void BenchmarkCompaction(ostream& out, int document_count, double removed_share, int query_count) {
+    SyntheticCorpusOptions options;
+    options.document_count = document_count;
+    options.query_count = query_count;
+    const SyntheticCorpus corpus = GenerateSyntheticCorpus(options);
+    SearchServer search_server(corpus.stop_words);
+    for (const SyntheticDocument& document : corpus.documents) {
+        search_server.AddDocument(document.document_id, document.text, document.status, document.ratings);
+    }
+    const auto print_stats = [&out](string_view name, const MemoryStats& stats) {
+        const double mib = 1.0 / (1 << 20);
+        out << "  "s << name << ": total "s << stats.GetTotal() * mib << " MiB, terms "s << stats.term_dictionary * mib
+            << ", postings "s << stats.postings * mib << ", forward index "s << stats.forward_index * mib
+            << ", documents "s << stats.document_table * mib << ", duplicates "s << stats.duplicate_detection * mib
+            << ", stop words "s << stats.stop_words * mib << " ("s << stats.dead_term_count << " dead terms, "s
+            << stats.dead_document_count << " removed documents)"s << endl;
+    };
+    const auto run_queries = [&] {
+        vector<vector<Document>> results;
+        results.reserve(corpus.queries.size());
+        const double seconds = MeasureSeconds([&] {
+            for (const string& query : corpus.queries) {
+                results.push_back(search_server.FindTopDocuments(query));
+            }
+        });
+        return pair{ query_count / seconds, move(results) };
+    };
+
+    out << "compaction, "s << document_count << " documents, "s << removed_share * 100 << "% removed"s << endl;
+    print_stats("indexed"sv, search_server.GetMemoryStats());
+    mt19937 generator(document_count);
+    bernoulli_distribution is_removed(removed_share);
+    vector<int> removed_ids;
+    for (const SyntheticDocument& document : corpus.documents) {
+        if (is_removed(generator)) {
+            removed_ids.push_back(document.document_id);
+        }
+    }
+    search_server.RemoveDocuments(removed_ids);
+    print_stats("removed"sv, search_server.GetMemoryStats());
+    const auto [queries_before, results_before] = run_queries();
+    const double compact_seconds = MeasureSeconds([&] {
+        search_server.Compact();
+    });
+    print_stats("compacted"sv, search_server.GetMemoryStats());
+    const auto [queries_after, results_after] = run_queries();
+    size_t mismatch_count = 0;
+    for (size_t i = 0; i < results_before.size(); ++i) {
+        mismatch_count += !equal(results_before[i].begin(), results_before[i].end(), results_after[i].begin(), results_after[i].end(),
+            [](const Document& lhs, const Document& rhs) {
+                return lhs.id == rhs.id;
+            });
+    }
+    out << "  compact "s << compact_seconds * 1e3 << " ms, queries "s << queries_before << " queries/s before, "s << queries_after
+        << " after, "s << mismatch_count << " mismatches"s << endl;
+}
+
+void BenchmarkWordFrequencies(ostream& out, int document_count, int repeat_count) {
+    SyntheticCorpusOptions options;
+    options.document_count = document_count;
+    options.query_count = 0;
+    const SyntheticCorpus corpus = GenerateSyntheticCorpus(options);
+    SearchServer search_server(corpus.stop_words);
+    for (const SyntheticDocument& document : corpus.documents) {
+        search_server.AddDocument(document.document_id, document.text, document.status, document.ratings);
+    }
+
+    out << "word frequencies, "s << document_count << " documents"s << endl;
+    const auto measure = [&](string_view name, auto get_words) {
+        double checksum = 0.0;
+        const double seconds = MeasureSeconds([&] {
+            for (int repeat = 0; repeat < repeat_count; ++repeat) {
+                for (const int document_id : search_server) {
+                    for (const auto& [word, term_freq] : get_words(document_id)) {
+                        checksum += term_freq * word.size();
+                    }
+                }
+            }
+        });
+        out << "  "s << name << ": "s << document_count * repeat_count / seconds << " documents/s (checksum "s << checksum << ")"s << endl;
+    };
+    measure("view"sv, [&search_server](int document_id) {
+        return search_server.GetWordFrequencies(document_id);
+    });
+    measure("map"sv, [&search_server](int document_id) {
+        return search_server.GetWordFrequencyMap(document_id);
+    });
+}
+
+void BenchmarkSuite(ostream& out, const SyntheticCorpusOptions& options) {
+    const SyntheticCorpus corpus = GenerateSyntheticCorpus(options);
+    const size_t document_count = corpus.documents.size();
+    const size_t query_count = corpus.queries.size();
+    out << "{\"benchmark\":\"corpus\",\"seed\":"s << options.seed << ",\"documents\":"s << document_count
+        << ",\"queries\":"s << query_count << ",\"vocabulary_size\":"s << options.vocabulary_size
+        << ",\"zipf_exponent\":"s << options.zipf_exponent << ",\"stop_word_ratio\":"s << options.stop_word_ratio
+        << ",\"peak_rss_bytes\":"s << GetPeakResidentBytes() << "}"s << endl;
+
+    SearchServer search_server(corpus.stop_words);
+    vector<double> add_seconds = MeasureEach(document_count, [&](size_t i) {
+        const SyntheticDocument& document = corpus.documents[i];
+        search_server.AddDocument(document.document_id, document.text, document.status, document.ratings);
+    });
+    PrintSuiteResult(out, "add_document"sv, move(add_seconds), search_server.GetDocumentCount());
+
+    const auto predicate = [](int, DocumentStatus, int rating) {
+        return rating > 0;
+    };
+    const auto measure_queries = [&](string_view name, const auto& find_top_documents) {
+        size_t result_count = 0;
+        vector<double> seconds = MeasureEach(query_count, [&](size_t i) {
+            result_count += find_top_documents(corpus.queries[i]).size();
+        });
+        PrintSuiteResult(out, name, move(seconds), result_count);
+    };
+    measure_queries("find_top_documents"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(query);
+    });
+    measure_queries("find_top_documents_status"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT);
+    });
+    measure_queries("find_top_documents_predicate"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(query, predicate);
+    });
+    measure_queries("find_top_documents_seq"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(execution::seq, query);
+    });
+    measure_queries("find_top_documents_seq_status"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(execution::seq, query, DocumentStatus::IRRELEVANT);
+    });
+    measure_queries("find_top_documents_seq_predicate"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(execution::seq, query, predicate);
+    });
+    measure_queries("find_top_documents_par"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(execution::par, query);
+    });
+    measure_queries("find_top_documents_par_status"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(execution::par, query, DocumentStatus::IRRELEVANT);
+    });
+    measure_queries("find_top_documents_par_predicate"sv, [&](const string& query) {
+        return search_server.FindTopDocuments(execution::par, query, predicate);
+    });
+
+    // Every query against a document spread over the ids
+    const auto measure_matches = [&](string_view name, const auto& match_document) {
+        size_t result_count = 0;
+        vector<double> seconds = MeasureEach(document_count > 0 ? query_count : 0, [&](size_t i) {
+            const int document_id = static_cast<int>(i * 7919 % document_count);
+            result_count += get<0>(match_document(corpus.queries[i], document_id)).size();
+        });
+        PrintSuiteResult(out, name, move(seconds), result_count);
+    };
+    measure_matches("match_document"sv, [&](const string& query, int document_id) {
+        return search_server.MatchDocument(query, document_id);
+    });
+    measure_matches("match_document_seq"sv, [&](const string& query, int document_id) {
+        return search_server.MatchDocument(execution::seq, query, document_id);
+    });
+    measure_matches("match_document_par"sv, [&](const string& query, int document_id) {
+        return search_server.MatchDocument(execution::par, query, document_id);
+    });
+
+    // Batches of all the queries
+    const size_t batch_count = 5;
+    size_t batch_result_count = 0;
+    vector<double> batch_seconds = MeasureEach(batch_count, [&](size_t) {
+        for (const auto& documents : ProcessQueries(search_server, corpus.queries)) {
+            batch_result_count += documents.size();
+        }
+    });
+    PrintSuiteResult(out, "process_queries"sv, move(batch_seconds), batch_result_count);
+    batch_result_count = 0;
+    batch_seconds = MeasureEach(batch_count, [&](size_t) {
+        batch_result_count += ProcessQueriesJoined(search_server, corpus.queries).size();
+    });
+    PrintSuiteResult(out, "process_queries_joined"sv, move(batch_seconds), batch_result_count);
+
+    // Removals from copies of the server, a tenth of the documents spread over the ids
+    const size_t removal_count = document_count / 10;
+    const auto measure_removals = [&](string_view name, const auto& remove_document) {
+        SearchServer copy = search_server;
+        vector<double> seconds = MeasureEach(removal_count, [&](size_t i) {
+            remove_document(copy, static_cast<int>(i * 10));
+        });
+        PrintSuiteResult(out, name, move(seconds), document_count - copy.GetDocumentCount());
+    };
+    measure_removals("remove_document"sv, [](SearchServer& server, int document_id) {
+        server.RemoveDocument(document_id);
+    });
+    measure_removals("remove_document_seq"sv, [](SearchServer& server, int document_id) {
+        server.RemoveDocument(execution::seq, document_id);
+    });
+    measure_removals("remove_document_par"sv, [](SearchServer& server, int document_id) {
+        server.RemoveDocument(execution::par, document_id);
+    });
+
+    // RemoveDuplicates reports every removal on cout, which would break the lines of the suite
+    ostringstream removal_messages;
+    streambuf* const cout_buffer = cout.rdbuf(removal_messages.rdbuf());
+    vector<double> deduplication_seconds;
+    size_t removed_count = 0;
+    for (int i = 0; i < 3; ++i) {
+        SearchServer copy = search_server;
+        deduplication_seconds.push_back(MeasureSeconds([&copy] {
+            RemoveDuplicates(copy);
+        }));
+        removed_count += document_count - copy.GetDocumentCount();
+        removal_messages.str({});
+    }
+    cout.rdbuf(cout_buffer);
+    PrintSuiteResult(out, "remove_duplicates"sv, move(deduplication_seconds), removed_count);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "synthetic_corpus.h"
+
+#include <iostream>
+
+// Scan throughput of a single term's postings: std::map<int, double> against PostingList
+void BenchmarkPostingScan(std::ostream& out, int posting_count = 1'000'000, int repeat_count = 20);
+
+// Posting memory, scan throughput and FindTopDocuments throughput of FLAT against COMPRESSED
+void BenchmarkPostingFormats(std::ostream& out, int document_count = 200'000, int query_count = 500);
+
+// Update() throughput of ConcurrentMap under 1 to max_thread_count threads, against a single mutex around std::map
+void BenchmarkConcurrentMap(std::ostream& out, int max_thread_count = 64, int operation_count = 2'000'000);
+
+// Cold-start indexing time: AddDocument one by one against a single AddDocuments batch
+void BenchmarkIndexing(std::ostream& out, int document_count = 200'000);
+
+// SaveSnapshot and LoadSnapshot times against reindexing, and query throughput of the mapped server
+void BenchmarkSnapshot(std::ostream& out, int document_count = 200'000, int query_count = 500);
+
+// FindTopDocuments throughput over a repetitive query stream with and without the result cache
+void BenchmarkResultCache(std::ostream& out, int document_count = 100'000, int query_count = 20'000);
+
+// Per-query latency of a mixed batch of short and long queries: a parallel transform that
+// returns everything at the end against streaming ProcessQueries on the thread pool
+void BenchmarkQueryBatch(std::ostream& out, int document_count = 100'000, int query_count = 2'000);
+
+// ProcessQueriesJoined over a batch of short queries against joining per-query vectors into a list
+void BenchmarkJoinedResults(std::ostream& out, int document_count = 100'000, int query_count = 20'000);
+
+// FindDuplicates and RemoveDuplicates over a corpus where every tenth document repeats an
+// earlier one, against the pairwise comparison on pairwise_document_count documents
+void BenchmarkDeduplication(std::ostream& out, int document_count = 1'000'000, int pairwise_document_count = 5'000);
+
+// Indexing cost of MinHash signatures and FindNearDuplicates time and recall over a corpus
+// where every tenth document is an earlier one with a tenth of its words replaced
+void BenchmarkNearDuplicates(std::ostream& out, int document_count = 200'000);
+
+// Tokenizing throughput of the scalar, SSE2 and AVX2 tokenizers against checking and splitting in separate passes
+void BenchmarkTokenizer(std::ostream& out, int document_count = 100'000, int repeat_count = 10);
+
+// Query latency while batches of documents are replaced on another thread: a global mutex
+// around SearchServer against ConcurrentSearchServer snapshots
+void BenchmarkIngestion(std::ostream& out, int document_count = 200'000, int ingested_count = 20'000, int batch_size = 200);
+
+// Cost per request of RequestStatistics::Record under 1 to max_thread_count threads, against
+// the deque of copied queries and results RequestQueue kept before
+void BenchmarkRequestStatistics(std::ostream& out, int max_thread_count = 8, int operation_count = 10'000'000);
+
+// Query throughput of the build, plus the time per phase and the counters when it is
+// built with SEARCH_SERVER_INSTRUMENTATION; build it both ways to see the overhead
+void BenchmarkInstrumentation(std::ostream& out, int document_count = 100'000, int query_count = 20'000);
+
+// Query throughput of exhaustive scoring against MaxScore pruning over a synthetic corpus, for queries of
+// common words and for the queries of the corpus, checking that both find the same documents
+void BenchmarkRetrievalModes(std::ostream& out, int document_count = 100'000, int query_count = 2'000);
+
+// Query throughput of filtering on status with a lambda, called per document, against the
+// DocumentStatus overload, filtered by the status bitmaps, in both retrieval modes
+void BenchmarkStatusFilter(std::ostream& out, int document_count = 100'000, int query_count = 2'000);
+
+// Time to serve the first page_count pages of page_size documents per query: finding every
+// match and paginating it, FindDocumentsPage with offsets and with cursors. Also checks that
+// the cursors of the first queries, followed to the end, give the whole ranking
+void BenchmarkPages(std::ostream& out, int document_count = 100'000, int query_count = 500, int page_count = 20, int page_size = 10);
+
+// GetMemoryStats by part after indexing, after removing removed_share of the documents and
+// after Compact, the time Compact takes and query throughput before and after it
+void BenchmarkCompaction(std::ostream& out, int document_count = 200'000, double removed_share = 0.5, int query_count = 2'000);
+
+// Reading the words of every document through the GetWordFrequencies view and through the
+// GetWordFrequencyMap copy, repeat_count passes each
+void BenchmarkWordFrequencies(std::ostream& out, int document_count = 200'000, int repeat_count = 5);
+
+// Throughput and latency percentiles of every FindTopDocuments overload, MatchDocument,
+// AddDocument, RemoveDocument, RemoveDuplicates and the ProcessQueries functions over a
+// synthetic corpus, one JSON line per operation, to compare runs across commits. The peak
+// resident set is that of the whole process so far, so run the suite in a process of its own
+void BenchmarkSuite(std::ostream& out, const SyntheticCorpusOptions& options = {});
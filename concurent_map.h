@@ -1,49 +1,225 @@
 #pragma once
 
-template <typename Key, typename Value>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Hash map split into independently locked stripes. Every stripe is an open
+// addressing table with linear probing and backward-shift deletion, and sits on
+// its own cache line so that threads working on different stripes don't share one.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
 class ConcurrentMap {
 private:
-    struct Bucket;
+    struct Stripe;
 
 public:
-    static_assert(std::is_integral_v<Key>);
-
+    // Keeps the stripe locked while the reference is in use
     struct Access {
-        std::lock_guard <std::mutex> guard;
+        std::lock_guard<std::mutex> guard;
         Value& ref_to_value;
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex),
-            ref_to_value(bucket.std::map[key])
+        Access(const Key& key, Stripe& stripe)
+            : guard(stripe.mutex)
+            , ref_to_value(stripe.FindOrInsert(key))
         {
         }
     };
 
-    explicit Concurrentstd::map(size_t bucket_count)
+    explicit ConcurrentMap(size_t stripe_count)
+        : stripes_(std::max<size_t>(stripe_count, 1))
     {
-        buckets_ = new Bucket[bucket_count];
-        buckets_size_ = bucket_count;
     }
 
     Access operator[](const Key& key) {
-        auto& bucket = buckets_[key % buckets_size_];
-        return { key, bucket };
+        return { key, GetStripe(key) };
+    }
+
+    // Calls function(Value&) under the stripe lock, inserting a default value first if needed
+    template <typename Function>
+    void Update(const Key& key, Function function) {
+        Stripe& stripe = GetStripe(key);
+        std::lock_guard guard(stripe.mutex);
+        function(stripe.FindOrInsert(key));
+    }
+
+    std::optional<Value> Find(const Key& key) const {
+        const Stripe& stripe = GetStripe(key);
+        std::lock_guard guard(stripe.mutex);
+        const size_t index = stripe.FindIndex(key);
+        if (index == Stripe::NPOS) {
+            return std::nullopt;
+        }
+        return stripe.slots[index]->second;
     }
 
-    std::map<Key, Value> BuildOrdinarystd::map() {
-        std::map<Key, Value> result;
-        for (int i = 0; i < buckets_size_; ++i) {
-            std::lock_guard guard(buckets_[i].mutex);
-            result.insert(buckets_[i].std::map.begin(), buckets_[i].std::map.end());
+    bool Erase(const Key& key) {
+        Stripe& stripe = GetStripe(key);
+        std::lock_guard guard(stripe.mutex);
+        return stripe.Erase(key);
+    }
+
+    size_t size() const {
+        size_t result = 0;
+        for (const Stripe& stripe : stripes_) {
+            std::lock_guard guard(stripe.mutex);
+            result += stripe.size;
         }
         return result;
     }
 
+    // Stripes are copied out in parallel, each under its own lock, and the result is sorted by key
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> BuildSortedVector(ExecutionPolicy&& policy) const {
+        std::vector<std::vector<std::pair<Key, Value>>> parts(stripes_.size());
+        std::vector<size_t> indexes(stripes_.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(policy, indexes.begin(), indexes.end(), [this, &parts](size_t index) {
+            const Stripe& stripe = stripes_[index];
+            std::lock_guard guard(stripe.mutex);
+            parts[index].reserve(stripe.size);
+            for (const auto& slot : stripe.slots) {
+                if (slot) {
+                    parts[index].push_back(*slot);
+                }
+            }
+        });
+
+        std::vector<size_t> offsets(parts.size() + 1, 0);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            offsets[i + 1] = offsets[i] + parts[i].size();
+        }
+        std::vector<std::pair<Key, Value>> result(offsets.back());
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            std::move(parts[index].begin(), parts[index].end(), result.begin() + offsets[index]);
+        });
+        std::sort(policy, result.begin(), result.end(),
+            [](const auto& lhs, const auto& rhs) {
+                return lhs.first < rhs.first;
+            });
+        return result;
+    }
+
+    std::vector<std::pair<Key, Value>> BuildSortedVector() const {
+        return BuildSortedVector(std::execution::par);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        const auto entries = BuildSortedVector();
+        return { entries.begin(), entries.end() };
+    }
+
 private:
-    struct Bucket {
-        std::mutex mutex;
-        std::map<Key, Value> map;
+    struct alignas(64) Stripe {
+        static constexpr size_t NPOS = static_cast<size_t>(-1);
+        static constexpr size_t MIN_CAPACITY = 8;
+
+        mutable std::mutex mutex;
+        std::vector<std::optional<std::pair<Key, Value>>> slots;
+        size_t size = 0;
+
+        size_t GetHome(const Key& key) const {
+            // Stripe selection used the low bits, slot selection takes the high ones. The hash is
+            // 64-bit even where size_t is 32-bit, so the high half exists on every target
+            return static_cast<size_t>(MixHash(key) >> 32) & (slots.size() - 1);
+        }
+
+        size_t FindIndex(const Key& key) const {
+            if (slots.empty()) {
+                return NPOS;
+            }
+            const size_t mask = slots.size() - 1;
+            for (size_t index = GetHome(key); slots[index]; index = (index + 1) & mask) {
+                if (KeyEqual{}(slots[index]->first, key)) {
+                    return index;
+                }
+            }
+            return NPOS;
+        }
+
+        Value& FindOrInsert(const Key& key) {
+            if (const size_t index = FindIndex(key); index != NPOS) {
+                return slots[index]->second;
+            }
+            // Keep the load factor under 3/4
+            if ((size + 1) * 4 > slots.size() * 3) {
+                Grow();
+            }
+            const size_t mask = slots.size() - 1;
+            size_t index = GetHome(key);
+            while (slots[index]) {
+                index = (index + 1) & mask;
+            }
+            slots[index].emplace(key, Value{});
+            ++size;
+            return slots[index]->second;
+        }
+
+        bool Erase(const Key& key) {
+            size_t hole = FindIndex(key);
+            if (hole == NPOS) {
+                return false;
+            }
+            slots[hole].reset();
+            --size;
+
+            // Shift back the following entries of the probe sequence that may no longer be reachable
+            const size_t mask = slots.size() - 1;
+            for (size_t index = (hole + 1) & mask; slots[index]; index = (index + 1) & mask) {
+                const size_t home = GetHome(slots[index]->first);
+                const bool reachable = hole <= index
+                    ? hole < home && home <= index
+                    : hole < home || home <= index;
+                if (!reachable) {
+                    slots[hole] = std::move(slots[index]);
+                    slots[index].reset();
+                    hole = index;
+                }
+            }
+            return true;
+        }
+
+        void Grow() {
+            std::vector<std::optional<std::pair<Key, Value>>> old_slots(std::max(MIN_CAPACITY, slots.size() * 2));
+            old_slots.swap(slots);
+            const size_t mask = slots.size() - 1;
+            for (auto& slot : old_slots) {
+                if (slot) {
+                    size_t index = GetHome(slot->first);
+                    while (slots[index]) {
+                        index = (index + 1) & mask;
+                    }
+                    slots[index] = std::move(slot);
+                }
+            }
+        }
     };
-    size_t buckets_size_;
-    Bucket* buckets_;
-};
\ No newline at end of file
+
+    // Finalizer of splitmix64: identity hashes of integers would otherwise fill stripes in order
+    static uint64_t MixHash(const Key& key) {
+        uint64_t hash = Hash{}(key);
+        hash ^= hash >> 30;
+        hash *= 0xbf58476d1ce4e5b9ULL;
+        hash ^= hash >> 27;
+        hash *= 0x94d049bb133111ebULL;
+        hash ^= hash >> 31;
+        return hash;
+    }
+
+    Stripe& GetStripe(const Key& key) {
+        return stripes_[static_cast<size_t>(MixHash(key) % stripes_.size())];
+    }
+
+    const Stripe& GetStripe(const Key& key) const {
+        return stripes_[static_cast<size_t>(MixHash(key) % stripes_.size())];
+    }
+
+    std::vector<Stripe> stripes_;
+};
@@ -0,0 +1,65 @@
+#include "concurrent_search_server.h"
+
+using namespace std;
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer search_server)
+    : version_count_(make_shared<atomic<size_t>>(0)) {
+    current_ = MakeVersion(make_unique<SearchServer>(move(search_server)));
+}
+
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::GetSnapshot() const {
+    lock_guard lock(current_mutex_);
+    return current_;
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    Modify([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(span<const DocumentInput> documents) {
+    Modify([documents](SearchServer& search_server) {
+        search_server.AddDocuments(documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Modify([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(span<const int> document_ids) {
+    Modify([document_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(document_ids);
+    });
+}
+
+void ConcurrentSearchServer::Compact() {
+    Modify([](SearchServer& search_server) {
+        search_server.Compact();
+    });
+}
+
+size_t ConcurrentSearchServer::GetRetiredVersionCount() const {
+    return version_count_->load() - 1;
+}
+
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::MakeVersion(unique_ptr<SearchServer> search_server) {
+    version_count_->fetch_add(1);
+    // The control block's reference counting orders the deletion after every reader's last access
+    return Snapshot(search_server.release(), [version_count = version_count_](const SearchServer* version) {
+        delete version;
+        version_count->fetch_sub(1);
+    });
+}
+
+void ConcurrentSearchServer::Publish(unique_ptr<SearchServer> version) {
+    Snapshot replaced = MakeVersion(move(version));
+    {
+        lock_guard lock(current_mutex_);
+        swap(current_, replaced);
+    }
+    // Freed here unless a snapshot still holds it; then the last one to let go frees it
+}
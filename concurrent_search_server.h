@@ -0,0 +1,65 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Serves searches while documents are added and removed. Readers search a snapshot: an
+// immutable version of the index that stays valid for as long as it is held, so they never
+// wait for a write. Writes are serialized; each one changes a copy of the current version,
+// which shares everything unchanged with it, and publishes the copy atomically. A replaced
+// version is freed as soon as no snapshot refers to it, by whichever thread drops the last one.
+class ConcurrentSearchServer {
+public:
+    using Snapshot = std::shared_ptr<const SearchServer>;
+
+    explicit ConcurrentSearchServer(SearchServer search_server);
+
+    Snapshot GetSnapshot() const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(std::span<const DocumentInput> documents);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(std::span<const int> document_ids);
+
+    // Compacts a copy, see SearchServer::Compact, while readers keep searching the current
+    // version; call it from a maintenance thread. Until the old version is retired both are
+    // in memory, and the copy shares nothing with it
+    void Compact();
+
+    // Runs update on a copy of the current version and publishes the copy, so readers see
+    // all of its changes or none. Every version costs a copy of the per-document and per-word
+    // attribute arrays; batching writes amortizes it. If update throws, nothing is published
+    template <typename Update>
+    void Modify(Update update);
+
+    // Replaced versions still held by snapshots
+    size_t GetRetiredVersionCount() const;
+
+private:
+    // Guards the pointer only: readers hold it for a copy, writers for a swap, never for a write
+    mutable std::mutex current_mutex_;
+    Snapshot current_;
+    std::mutex write_mutex_;
+    // Versions not freed yet, the current one included. The deleters of the versions share
+    // it, since snapshots may outlive the server
+    std::shared_ptr<std::atomic<size_t>> version_count_;
+
+    Snapshot MakeVersion(std::unique_ptr<SearchServer> search_server);
+    // Called under write_mutex_
+    void Publish(std::unique_ptr<SearchServer> version);
+};
+
+template <typename Update>
+void ConcurrentSearchServer::Modify(Update update) {
+    std::lock_guard lock(write_mutex_);
+    auto version = std::make_unique<SearchServer>(*GetSnapshot());
+    update(*version);
+    Publish(std::move(version));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "memory_usage.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// The object shared points to, ready for writing: cloned first if another owner still refers
+// to it. use_count() is a relaxed load, so when shared turns out to be the only owner, an
+// acquire fence orders the writes after the last accesses of the owners that released it
+template <typename T>
+T& GetUnshared(std::shared_ptr<T>& shared) {
+    if (shared.use_count() > 1) {
+        shared = std::make_shared<T>(*shared);
+    }
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *shared;
+}
+
+// Vector stored in fixed-size chunks that copies share. Copying copies the chunk pointers
+// only; Mutable and the other writes clone a chunk first if another copy still refers to it.
+// So a copy may be written while other threads read the original, but two copies must not
+// be copied from or written to concurrently
+template <typename T, size_t CHUNK_SIZE = 256>
+class CowVector {
+public:
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    const T& operator[](size_t index) const noexcept {
+        return chunks_[index / CHUNK_SIZE]->items[index % CHUNK_SIZE];
+    }
+
+    T& Mutable(size_t index) {
+        return GetMutableChunk(index / CHUNK_SIZE).items[index % CHUNK_SIZE];
+    }
+
+    void push_back(T value) {
+        if (size_ % CHUNK_SIZE == 0) {
+            chunks_.push_back(std::make_shared<Chunk>());
+        }
+        GetMutableChunk(size_ / CHUNK_SIZE).items[size_ % CHUNK_SIZE] = std::move(value);
+        ++size_;
+    }
+
+    // Only grows the vector
+    void resize(size_t size, const T& value = T()) {
+        while (size_ < size) {
+            push_back(value);
+        }
+    }
+
+    void clear() noexcept {
+        chunks_.clear();
+        size_ = 0;
+    }
+
+    // Heap bytes of the chunks, shared ones included, but not what the items own
+    size_t GetMemoryUsage() const noexcept {
+        return chunks_.capacity() * sizeof(std::shared_ptr<Chunk>) + chunks_.size() * (sizeof(Chunk) + SHARED_CONTROL_BLOCK_SIZE);
+    }
+
+private:
+    // Slots past the end of the last chunk hold default values
+    struct Chunk {
+        std::array<T, CHUNK_SIZE> items;
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+
+    Chunk& GetMutableChunk(size_t chunk_index) {
+        return GetUnshared(chunks_[chunk_index]);
+    }
+};
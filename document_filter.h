@@ -0,0 +1,27 @@
+#pragma once
+
+#include "document.h"
+
+#include <type_traits>
+
+// Predicate of the DocumentStatus overloads of FindTopDocuments, usable with the
+// DocumentPredicate ones as well
+struct StatusFilter {
+    DocumentStatus status = DocumentStatus::ACTUAL;
+
+    bool operator()(int, DocumentStatus document_status, int) const noexcept {
+        return document_status == status;
+    }
+};
+
+// Predicates that accept exactly the documents with their `status` member. SearchServer
+// filters them with the status bitmaps of its documents before scoring, instead of calling
+// them per document; other predicates are called as before
+template <typename DocumentPredicate>
+struct IsStatusFilter : std::false_type {};
+
+template <>
+struct IsStatusFilter<StatusFilter> : std::true_type {};
+
+template <typename DocumentPredicate>
+inline constexpr bool IS_STATUS_FILTER = IsStatusFilter<std::remove_cvref_t<DocumentPredicate>>::value;
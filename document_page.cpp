@@ -0,0 +1,70 @@
+#include "document_page.h"
+
+#include <bit>
+#include <charconv>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const string_view CURSOR_PREFIX = "p1:"sv;
+
+template <typename Integer>
+void AppendField(string& text, Integer value, int base = 10) {
+    char buffer[24];
+    const auto result = to_chars(begin(buffer), end(buffer), value, base);
+    text.append(buffer, result.ptr);
+    text += ':';
+}
+
+// Reads the integer up to the next ':' and skips the ':'
+template <typename Integer>
+Integer ReadField(string_view& text, int base = 10) {
+    const size_t separator = text.find(':');
+    Integer value{};
+    if (separator == string_view::npos
+        || from_chars(text.data(), text.data() + separator, value, base).ptr != text.data() + separator) {
+        throw invalid_argument("некорректный курсор страницы"s);
+    }
+    text.remove_prefix(separator + 1);
+    return value;
+}
+
+}
+
+// p1:end:epoch:status:position:id:rating:relevance bits in hex:raw query
+string PageCursor::ToString() const {
+    string text(CURSOR_PREFIX);
+    AppendField(text, static_cast<int>(is_end_));
+    AppendField(text, epoch_);
+    AppendField(text, static_cast<int>(status_));
+    AppendField(text, position_);
+    AppendField(text, last_.id);
+    AppendField(text, last_.rating);
+    AppendField(text, bit_cast<uint64_t>(last_.relevance), 16);
+    text += raw_query_;
+    return text;
+}
+
+PageCursor PageCursor::FromString(string_view text) {
+    if (!text.starts_with(CURSOR_PREFIX)) {
+        throw invalid_argument("некорректный курсор страницы"s);
+    }
+    text.remove_prefix(CURSOR_PREFIX.size());
+    PageCursor cursor;
+    const int is_end = ReadField<int>(text);
+    cursor.epoch_ = ReadField<uint64_t>(text);
+    const int status = ReadField<int>(text);
+    cursor.position_ = ReadField<size_t>(text);
+    cursor.last_.id = ReadField<int>(text);
+    cursor.last_.rating = ReadField<int>(text);
+    cursor.last_.relevance = bit_cast<double>(ReadField<uint64_t>(text, 16));
+    if ((is_end != 0 && is_end != 1) || status < 0 || status > static_cast<int>(DocumentStatus::REMOVED)) {
+        throw invalid_argument("некорректный курсор страницы"s);
+    }
+    cursor.is_end_ = is_end == 1;
+    cursor.status_ = static_cast<DocumentStatus>(status);
+    cursor.raw_query_ = text;
+    return cursor;
+}
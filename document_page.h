@@ -0,0 +1,61 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class SearchServer;
+
+// Where a page of SearchServer::FindDocumentsPage ended: the query, the status filter and
+// the last document returned. The next page holds the documents ranked below that document,
+// so pages never shift when documents above them come and go.
+//
+// Within one epoch of the index the pages of a cursor are consecutive slices of the ranking.
+// After the index changes, relevances move with it: the next page still starts below the
+// last document returned, in the new ranking
+class PageCursor {
+public:
+    // An ended cursor: continuing from it finds nothing
+    PageCursor() = default;
+
+    // No page follows; continuing from the cursor finds nothing
+    bool IsEnd() const noexcept {
+        return is_end_;
+    }
+
+    // Epoch of the index the last page was found in, see SearchServer::GetEpoch
+    uint64_t GetEpoch() const noexcept {
+        return epoch_;
+    }
+
+    // Documents returned before the next page
+    size_t GetPosition() const noexcept {
+        return position_;
+    }
+
+    // Printable token, for handing the cursor to clients
+    std::string ToString() const;
+    // Throws std::invalid_argument for a token ToString didn't produce
+    static PageCursor FromString(std::string_view text);
+
+private:
+    friend class SearchServer;
+
+    std::string raw_query_;
+    DocumentStatus status_ = DocumentStatus::ACTUAL;
+    uint64_t epoch_ = 0;
+    size_t position_ = 0;
+    // Set unless the cursor has ended or is still at position 0
+    Document last_;
+    bool is_end_ = true;
+};
+
+struct DocumentPage {
+    // Best first
+    std::vector<Document> documents;
+    PageCursor next;
+};
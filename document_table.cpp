@@ -0,0 +1,208 @@
+#include "document_table.h"
+#include "memory_usage.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+DocumentTable::Iterator::Iterator(const DocumentTable* table, int document_id)
+    : table_(table)
+    , document_id_(document_id) {
+}
+
+DocumentTable::Iterator& DocumentTable::Iterator::operator++() {
+    document_id_ = table_->FindNext(document_id_ + 1);
+    return *this;
+}
+
+DocumentTable::Iterator DocumentTable::Iterator::operator++(int) {
+    Iterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+int DocumentTable::Add(int document_id, int rating, DocumentStatus status) {
+    if (is_mapped_) {
+        throw logic_error("a document table loaded from a snapshot is read-only"s);
+    }
+    Page& page = pages_[document_id / PAGE_SIZE];
+    if (page.ordinals.empty()) {
+        page.ordinals.assign(PAGE_SIZE, NO_DOCUMENT);
+    }
+
+    const int ordinal = GetOrdinalCount();
+    page.ordinals[document_id % PAGE_SIZE] = ordinal;
+    ++page.size;
+    document_ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(status);
+    alive_.push_back(1);
+    for (vector<uint64_t>& bitmap : status_bitmaps_) {
+        bitmap.resize(OrdinalBitmap::GetWordCount(ordinal + 1));
+    }
+    status_bitmaps_[static_cast<size_t>(status)][ordinal / OrdinalBitmap::WORD_BITS] |= uint64_t{ 1 } << (ordinal % OrdinalBitmap::WORD_BITS);
+    ++live_count_;
+    return ordinal;
+}
+
+int DocumentTable::Remove(int document_id) {
+    if (is_mapped_) {
+        throw logic_error("a document table loaded from a snapshot is read-only"s);
+    }
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal == NO_DOCUMENT) {
+        return NO_DOCUMENT;
+    }
+    const auto page = pages_.find(document_id / PAGE_SIZE);
+    if (--page->second.size == 0) {
+        pages_.erase(page);
+    }
+    else {
+        page->second.ordinals[document_id % PAGE_SIZE] = NO_DOCUMENT;
+    }
+    alive_[ordinal] = 0;
+    status_bitmaps_[static_cast<size_t>(statuses_[ordinal])][ordinal / OrdinalBitmap::WORD_BITS] &= ~(uint64_t{ 1 } << (ordinal % OrdinalBitmap::WORD_BITS));
+    --live_count_;
+    return ordinal;
+}
+
+int DocumentTable::FindOrdinal(int document_id) const noexcept {
+    if (document_id < 0) {
+        return NO_DOCUMENT;
+    }
+    if (is_mapped_) {
+        const auto it = lower_bound(mapped_.live_ids.begin(), mapped_.live_ids.end(), document_id);
+        return it != mapped_.live_ids.end() && *it == document_id ? mapped_.live_ordinals[it - mapped_.live_ids.begin()] : NO_DOCUMENT;
+    }
+    const auto page = pages_.find(document_id / PAGE_SIZE);
+    return page != pages_.end() ? page->second.ordinals[document_id % PAGE_SIZE] : NO_DOCUMENT;
+}
+
+DocumentTable::Iterator DocumentTable::begin() const {
+    return { this, FindNext(0) };
+}
+
+DocumentTable::Iterator DocumentTable::end() const {
+    return { this, NO_DOCUMENT };
+}
+
+vector<int> DocumentTable::Compact() {
+    if (is_mapped_) {
+        throw logic_error("a document table loaded from a snapshot is read-only"s);
+    }
+    vector<int> new_ordinals(GetOrdinalCount(), NO_DOCUMENT);
+    DocumentTable compacted;
+    compacted.document_ids_.reserve(live_count_);
+    compacted.ratings_.reserve(live_count_);
+    compacted.statuses_.reserve(live_count_);
+    compacted.alive_.reserve(live_count_);
+    for (vector<uint64_t>& bitmap : compacted.status_bitmaps_) {
+        bitmap.reserve(OrdinalBitmap::GetWordCount(live_count_));
+    }
+    for (int ordinal = 0; ordinal < GetOrdinalCount(); ++ordinal) {
+        if (alive_[ordinal]) {
+            new_ordinals[ordinal] = compacted.Add(document_ids_[ordinal], ratings_[ordinal], statuses_[ordinal]);
+        }
+    }
+    *this = move(compacted);
+    return new_ordinals;
+}
+
+size_t DocumentTable::GetMemoryUsage() const noexcept {
+    size_t usage = EstimateMemoryUsage(document_ids_) + EstimateMemoryUsage(ratings_) + EstimateMemoryUsage(statuses_)
+        + EstimateMemoryUsage(alive_) + EstimateMemoryUsage(pages_);
+    for (const vector<uint64_t>& bitmap : status_bitmaps_) {
+        usage += EstimateMemoryUsage(bitmap);
+    }
+    for (const auto& [index, page] : pages_) {
+        usage += EstimateMemoryUsage(page.ordinals);
+    }
+    return usage;
+}
+
+void DocumentTable::Save(SnapshotWriter& writer) const {
+    vector<int> document_ids(GetOrdinalCount());
+    vector<int> ratings(document_ids.size());
+    vector<DocumentStatus> statuses(document_ids.size());
+    vector<uint8_t> alive(document_ids.size());
+    for (int ordinal = 0; ordinal < GetOrdinalCount(); ++ordinal) {
+        document_ids[ordinal] = GetDocumentId(ordinal);
+        ratings[ordinal] = GetRating(ordinal);
+        statuses[ordinal] = GetStatus(ordinal);
+        alive[ordinal] = IsAlive(ordinal);
+    }
+    vector<int> live_ids(begin(), end());
+    vector<int> live_ordinals;
+    live_ordinals.reserve(live_ids.size());
+    for (const int document_id : live_ids) {
+        live_ordinals.push_back(FindOrdinal(document_id));
+    }
+
+    writer.WriteArray(span<const int>(document_ids));
+    writer.WriteArray(span<const int>(ratings));
+    writer.WriteArray(span<const DocumentStatus>(statuses));
+    writer.WriteArray(span<const uint8_t>(alive));
+    for (size_t status = 0; status < STATUS_COUNT; ++status) {
+        writer.WriteArray(is_mapped_ ? mapped_.status_bitmaps[status] : span<const uint64_t>(status_bitmaps_[status]));
+    }
+    writer.WriteArray(span<const int>(live_ids));
+    writer.WriteArray(span<const int>(live_ordinals));
+}
+
+DocumentTable DocumentTable::Load(SnapshotReader& reader) {
+    DocumentTable table;
+    table.is_mapped_ = true;
+    MappedArrays& mapped = table.mapped_;
+    mapped.document_ids = reader.ReadArray<int>();
+    mapped.ratings = reader.ReadArray<int>();
+    mapped.statuses = reader.ReadArray<DocumentStatus>();
+    mapped.alive = reader.ReadArray<uint8_t>();
+    for (span<const uint64_t>& bitmap : mapped.status_bitmaps) {
+        bitmap = reader.ReadArray<uint64_t>();
+    }
+    mapped.live_ids = reader.ReadArray<int>();
+    mapped.live_ordinals = reader.ReadArray<int>();
+    const size_t ordinal_count = mapped.document_ids.size();
+    if (mapped.ratings.size() != ordinal_count || mapped.statuses.size() != ordinal_count
+        || mapped.alive.size() != ordinal_count || mapped.live_ordinals.size() != mapped.live_ids.size()
+        || any_of(mapped.status_bitmaps.begin(), mapped.status_bitmaps.end(), [ordinal_count](span<const uint64_t> bitmap) {
+            return bitmap.size() != OrdinalBitmap::GetWordCount(static_cast<int>(ordinal_count));
+        })) {
+        throw invalid_argument("snapshot document table is inconsistent"s);
+    }
+    // FindOrdinal searches live_ids and trusts the ordinals next to them
+    bool is_consistent = all_of(mapped.statuses.begin(), mapped.statuses.end(), [](DocumentStatus status) {
+            return static_cast<size_t>(status) < STATUS_COUNT;
+        })
+        && adjacent_find(mapped.live_ids.begin(), mapped.live_ids.end(), greater_equal<>()) == mapped.live_ids.end();
+    for (size_t i = 0; is_consistent && i < mapped.live_ids.size(); ++i) {
+        const int ordinal = mapped.live_ordinals[i];
+        is_consistent = ordinal >= 0 && static_cast<size_t>(ordinal) < ordinal_count && mapped.document_ids[ordinal] == mapped.live_ids[i]
+            && mapped.alive[ordinal] != 0;
+    }
+    if (!is_consistent) {
+        throw invalid_argument("snapshot document table is inconsistent"s);
+    }
+    table.live_count_ = static_cast<int>(mapped.live_ids.size());
+    return table;
+}
+
+int DocumentTable::FindNext(int document_id) const {
+    if (is_mapped_) {
+        const auto it = lower_bound(mapped_.live_ids.begin(), mapped_.live_ids.end(), document_id);
+        return it != mapped_.live_ids.end() ? *it : NO_DOCUMENT;
+    }
+    const int first_page = document_id / PAGE_SIZE;
+    for (auto page = pages_.lower_bound(first_page); page != pages_.end(); ++page) {
+        const int first = page->first == first_page ? document_id % PAGE_SIZE : 0;
+        for (int slot = first; slot < PAGE_SIZE; ++slot) {
+            if (page->second.ordinals[slot] != NO_DOCUMENT) {
+                return page->first * PAGE_SIZE + slot;
+            }
+        }
+    }
+    return NO_DOCUMENT;
+}
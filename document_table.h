@@ -0,0 +1,155 @@
+#pragma once
+
+#include "document.h"
+#include "ordinal_bitmap.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <span>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Document attributes stored as structure-of-arrays under compact ordinals.
+// Ordinals are handed out in order of addition and are not reused, so postings
+// keyed by ordinal stay sorted when appended. External ids are mapped to ordinals
+// through a paged slot table: a page is allocated only while it holds documents, and the
+// directory of pages is sparse, so a single large id costs one page rather than one per
+// PAGE_SIZE ids below it.
+// A table loaded from a snapshot reads its arrays from the mapping, finds ids by
+// binary search over the live ones and can't be modified.
+//
+// The live documents of every status are kept as bitmaps over the ordinals as well, so that
+// searches filtering on status test a bit instead of looking the status up.
+class DocumentTable {
+public:
+    static constexpr int NO_DOCUMENT = -1;
+    static constexpr int PAGE_SIZE = 1024;
+
+    // Iterates over external ids of live documents in ascending order
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        Iterator() = default;
+        Iterator(const DocumentTable* table, int document_id);
+
+        int operator*() const noexcept {
+            return document_id_;
+        }
+
+        Iterator& operator++();
+        Iterator operator++(int);
+
+        bool operator==(const Iterator& other) const noexcept {
+            return document_id_ == other.document_id_;
+        }
+
+        bool operator!=(const Iterator& other) const noexcept {
+            return !(*this == other);
+        }
+
+    private:
+        const DocumentTable* table_ = nullptr;
+        int document_id_ = NO_DOCUMENT;
+    };
+
+    // Returns the ordinal of the new document
+    int Add(int document_id, int rating, DocumentStatus status);
+
+    // Returns the ordinal the document had, or NO_DOCUMENT
+    int Remove(int document_id);
+
+    int FindOrdinal(int document_id) const noexcept;
+
+    bool Contains(int document_id) const noexcept {
+        return FindOrdinal(document_id) != NO_DOCUMENT;
+    }
+
+    int GetDocumentId(int ordinal) const noexcept {
+        return is_mapped_ ? mapped_.document_ids[ordinal] : document_ids_[ordinal];
+    }
+
+    int GetRating(int ordinal) const noexcept {
+        return is_mapped_ ? mapped_.ratings[ordinal] : ratings_[ordinal];
+    }
+
+    DocumentStatus GetStatus(int ordinal) const noexcept {
+        return is_mapped_ ? mapped_.statuses[ordinal] : statuses_[ordinal];
+    }
+
+    bool IsAlive(int ordinal) const noexcept {
+        return (is_mapped_ ? mapped_.alive[ordinal] : alive_[ordinal]) != 0;
+    }
+
+    // Live documents with the status; valid until the table changes
+    OrdinalBitmap GetStatusBitmap(DocumentStatus status) const noexcept {
+        const size_t index = static_cast<size_t>(status);
+        return OrdinalBitmap(is_mapped_ ? mapped_.status_bitmaps[index] : std::span<const uint64_t>(status_bitmaps_[index]));
+    }
+
+    // Number of live documents
+    int size() const noexcept {
+        return live_count_;
+    }
+
+    // Number of ordinals handed out so far, live or not
+    int GetOrdinalCount() const noexcept {
+        return static_cast<int>(is_mapped_ ? mapped_.document_ids.size() : document_ids_.size());
+    }
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    // Renumbers the live documents 0, 1, ... in their order and forgets the removed ones.
+    // Returns the new ordinal of every old one, NO_DOCUMENT for removed documents
+    std::vector<int> Compact();
+
+    // Heap bytes only: a table loaded from a snapshot owns none
+    size_t GetMemoryUsage() const noexcept;
+
+    void Save(SnapshotWriter& writer) const;
+    // The mapping behind reader must outlive the table
+    static DocumentTable Load(SnapshotReader& reader);
+
+private:
+    static constexpr size_t STATUS_COUNT = static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+
+    std::vector<int> document_ids_;
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<uint8_t> alive_;
+    std::array<std::vector<uint64_t>, STATUS_COUNT> status_bitmaps_;
+    int live_count_ = 0;
+
+    struct Page {
+        // Ordinal of every id of the page, NO_DOCUMENT for ids without a live document
+        std::vector<int> ordinals;
+        int size = 0;
+    };
+    // Pages with live documents by id / PAGE_SIZE. Ordered, so that FindNext walks ids in order
+    std::map<int, Page> pages_;
+
+    struct MappedArrays {
+        std::span<const int> document_ids;
+        std::span<const int> ratings;
+        std::span<const DocumentStatus> statuses;
+        std::span<const uint8_t> alive;
+        std::array<std::span<const uint64_t>, STATUS_COUNT> status_bitmaps;
+        // Ids of live documents in ascending order and their ordinals
+        std::span<const int> live_ids;
+        std::span<const int> live_ordinals;
+    };
+    bool is_mapped_ = false;
+    MappedArrays mapped_;
+
+    int FindNext(int document_id) const;
+};
@@ -0,0 +1,119 @@
+#include "forward_index.h"
+#include "cow_vector.h"
+#include "memory_usage.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+void ForwardIndex::Clear(int ordinal) {
+    if (is_mapped_) {
+        throw logic_error("a forward index loaded from a snapshot is read-only"s);
+    }
+    auto& [first, last] = GetMutableChunk(ordinal / CHUNK_SIZE).ranges[ordinal % CHUNK_SIZE];
+    last = first;
+}
+
+ForwardIndex::Entries ForwardIndex::GetEntries(int ordinal) const noexcept {
+    if (is_mapped_) {
+        const uint64_t first = mapped_.offsets[ordinal];
+        const size_t count = static_cast<size_t>(mapped_.offsets[ordinal + 1] - first);
+        return { mapped_.word_ids.subspan(first, count), mapped_.term_freqs.subspan(first, count) };
+    }
+    const Chunk& chunk = *chunks_[ordinal / CHUNK_SIZE];
+    const auto [first, last] = chunk.ranges[ordinal % CHUNK_SIZE];
+    return { span<const int>(chunk.word_ids).subspan(first, last - first), span<const double>(chunk.term_freqs).subspan(first, last - first) };
+}
+
+int ForwardIndex::GetOrdinalCount() const noexcept {
+    return static_cast<int>(is_mapped_ ? mapped_.offsets.size() - 1 : ordinal_count_);
+}
+
+size_t ForwardIndex::GetMemoryUsage() const noexcept {
+    size_t usage = EstimateMemoryUsage(chunks_);
+    for (const shared_ptr<Chunk>& chunk : chunks_) {
+        usage += sizeof(Chunk) + SHARED_CONTROL_BLOCK_SIZE + EstimateMemoryUsage(chunk->word_ids)
+            + EstimateMemoryUsage(chunk->term_freqs) + EstimateMemoryUsage(chunk->ranges);
+    }
+    return usage;
+}
+
+void ForwardIndex::Save(SnapshotWriter& writer) const {
+    if (is_mapped_) {
+        writer.WriteArray(mapped_.offsets);
+        writer.WriteArray(mapped_.word_ids);
+        writer.WriteArray(mapped_.term_freqs);
+        return;
+    }
+    // Removed documents leave gaps in the chunks, which the saved arrays close
+    vector<uint64_t> offsets = { 0 };
+    vector<int> word_ids;
+    vector<double> term_freqs;
+    offsets.reserve(ordinal_count_ + 1);
+    for (int ordinal = 0; ordinal < GetOrdinalCount(); ++ordinal) {
+        const Entries entries = GetEntries(ordinal);
+        word_ids.insert(word_ids.end(), entries.word_ids.begin(), entries.word_ids.end());
+        term_freqs.insert(term_freqs.end(), entries.term_freqs.begin(), entries.term_freqs.end());
+        offsets.push_back(word_ids.size());
+    }
+    writer.WriteArray(span<const uint64_t>(offsets));
+    writer.WriteArray(span<const int>(word_ids));
+    writer.WriteArray(span<const double>(term_freqs));
+}
+
+ForwardIndex ForwardIndex::Load(SnapshotReader& reader, int term_count) {
+    ForwardIndex index;
+    index.is_mapped_ = true;
+    index.mapped_.offsets = reader.ReadArray<uint64_t>();
+    index.mapped_.word_ids = reader.ReadArray<int>();
+    index.mapped_.term_freqs = reader.ReadArray<double>();
+    const span<const uint64_t> offsets = index.mapped_.offsets;
+    const span<const int> word_ids = index.mapped_.word_ids;
+    if (offsets.empty() || offsets.front() != 0 || offsets.back() != word_ids.size()
+        || index.mapped_.term_freqs.size() != word_ids.size() || !is_sorted(offsets.begin(), offsets.end())
+        || any_of(word_ids.begin(), word_ids.end(), [term_count](int word_id) {
+            return word_id < 0 || word_id >= term_count;
+        })) {
+        throw invalid_argument("snapshot forward index is inconsistent"s);
+    }
+    for (size_t ordinal = 0; ordinal + 1 < offsets.size(); ++ordinal) {
+        const auto first = word_ids.begin() + offsets[ordinal];
+        const auto last = word_ids.begin() + offsets[ordinal + 1];
+        if (adjacent_find(first, last, greater_equal<>()) != last) {
+            throw invalid_argument("snapshot forward index is inconsistent"s);
+        }
+    }
+    return index;
+}
+
+ForwardIndex::Chunk& ForwardIndex::GetMutableChunk(size_t chunk_index) {
+    return GetUnshared(chunks_[chunk_index]);
+}
+
+ForwardIndex::Chunk& ForwardIndex::GetAppendChunk() {
+    if (is_mapped_) {
+        throw logic_error("a forward index loaded from a snapshot is read-only"s);
+    }
+    if (ordinal_count_ % CHUNK_SIZE == 0) {
+        chunks_.push_back(make_shared<Chunk>());
+        chunks_.back()->ranges.reserve(CHUNK_SIZE);
+    }
+    return GetMutableChunk(ordinal_count_ / CHUNK_SIZE);
+}
+
+void ForwardIndex::CloseChunk(Chunk& chunk) {
+    chunk.word_ids.shrink_to_fit();
+    chunk.term_freqs.shrink_to_fit();
+}
+
+double WordFrequencyView::GetTermFreq(string_view word) const {
+    const int word_id = terms_ ? terms_->FindTerm(word) : TermDictionary::NO_TERM;
+    if (word_id == TermDictionary::NO_TERM) {
+        return 0.0;
+    }
+    const auto it = lower_bound(entries_.word_ids.begin(), entries_.word_ids.end(), word_id);
+    return it != entries_.word_ids.end() && *it == word_id ? entries_.term_freqs[it - entries_.word_ids.begin()] : 0.0;
+}
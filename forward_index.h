@@ -0,0 +1,184 @@
+#pragma once
+
+#include "term_dictionary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Words of every document by ordinal: a contiguous run of word ids, ascending, and a parallel
+// run of their term frequencies. Documents are stored in chunks of CHUNK_SIZE ordinals, each
+// holding the runs of its documents back to back, and copies share the chunks: a write clones
+// the chunk first if another copy still refers to it. A removed document keeps the space of
+// its runs until the index is rebuilt. An index loaded from a snapshot reads the runs from the
+// mapping and can't be modified.
+class ForwardIndex {
+public:
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    struct Entries {
+        std::span<const int> word_ids;
+        std::span<const double> term_freqs;
+    };
+
+    // Appends the next ordinal. word_freqs holds (word id, term frequency) pairs sorted by word id
+    template <typename WordFreqs>
+    void Add(const WordFreqs& word_freqs);
+
+    // Leaves the ordinal without words
+    void Clear(int ordinal);
+
+    Entries GetEntries(int ordinal) const noexcept;
+
+    int GetOrdinalCount() const noexcept;
+
+    // Heap bytes, shared chunks included; an index loaded from a snapshot owns none
+    size_t GetMemoryUsage() const noexcept;
+
+    // Offsets of the runs as uint64, word ids and term frequencies, as three arrays
+    void Save(SnapshotWriter& writer) const;
+    // The mapping behind reader must outlive the index. Throws std::invalid_argument unless every
+    // run is ascending and below term_count
+    static ForwardIndex Load(SnapshotReader& reader, int term_count);
+
+private:
+    struct Chunk {
+        std::vector<int> word_ids;
+        std::vector<double> term_freqs;
+        // [first, last) of the runs of every ordinal of the chunk
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t ordinal_count_ = 0;
+
+    // Runs of ordinal i are [offsets[i], offsets[i + 1]) of the other two arrays
+    struct MappedArrays {
+        std::span<const uint64_t> offsets;
+        std::span<const int> word_ids;
+        std::span<const double> term_freqs;
+    };
+    bool is_mapped_ = false;
+    MappedArrays mapped_;
+
+    Chunk& GetMutableChunk(size_t chunk_index);
+    // The chunk the next ordinal goes to
+    Chunk& GetAppendChunk();
+    // A full chunk takes no more ordinals, so it gives back its spare capacity
+    void CloseChunk(Chunk& chunk);
+};
+
+template <typename WordFreqs>
+void ForwardIndex::Add(const WordFreqs& word_freqs) {
+    Chunk& chunk = GetAppendChunk();
+    const auto first = static_cast<uint32_t>(chunk.word_ids.size());
+    for (const auto& [word_id, term_freq] : word_freqs) {
+        chunk.word_ids.push_back(word_id);
+        chunk.term_freqs.push_back(term_freq);
+    }
+    chunk.ranges.emplace_back(first, static_cast<uint32_t>(chunk.word_ids.size()));
+    ++ordinal_count_;
+    if (chunk.ranges.size() == CHUNK_SIZE) {
+        CloseChunk(chunk);
+    }
+}
+
+// Words of one document with their term frequencies, sorted by word id, read in place from a
+// ForwardIndex. Iterating allocates nothing. Valid until the server it came from changes
+class WordFrequencyView {
+public:
+    using value_type = std::pair<std::string_view, double>;
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = WordFrequencyView::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+
+        Iterator(const TermDictionary* terms, const int* word_id, const double* term_freq) noexcept
+            : terms_(terms)
+            , word_id_(word_id)
+            , term_freq_(term_freq) {
+        }
+
+        value_type operator*() const {
+            return { terms_->GetTerm(*word_id_), *term_freq_ };
+        }
+
+        Iterator& operator++() noexcept {
+            ++word_id_;
+            ++term_freq_;
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const noexcept {
+            return word_id_ == other.word_id_;
+        }
+
+        bool operator!=(const Iterator& other) const noexcept {
+            return !(*this == other);
+        }
+
+    private:
+        const TermDictionary* terms_ = nullptr;
+        const int* word_id_ = nullptr;
+        const double* term_freq_ = nullptr;
+    };
+
+    WordFrequencyView() = default;
+
+    WordFrequencyView(const TermDictionary& terms, ForwardIndex::Entries entries) noexcept
+        : terms_(&terms)
+        , entries_(entries) {
+    }
+
+    Iterator begin() const noexcept {
+        return { terms_, entries_.word_ids.data(), entries_.term_freqs.data() };
+    }
+
+    Iterator end() const noexcept {
+        return { terms_, entries_.word_ids.data() + size(), entries_.term_freqs.data() + size() };
+    }
+
+    size_t size() const noexcept {
+        return entries_.word_ids.size();
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    // 0 for words the document doesn't have
+    double GetTermFreq(std::string_view word) const;
+
+    // Ids in the dictionary of the server, ascending, for work that needs no text
+    std::span<const int> GetWordIds() const noexcept {
+        return entries_.word_ids;
+    }
+
+    std::span<const double> GetTermFreqs() const noexcept {
+        return entries_.term_freqs;
+    }
+
+private:
+    const TermDictionary* terms_ = nullptr;
+    ForwardIndex::Entries entries_;
+};
@@ -0,0 +1,207 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace std;
+
+namespace {
+
+struct AtomicTotals {
+    atomic<uint64_t> call_count = 0;
+    atomic<uint64_t> total_ticks = 0;
+    array<atomic<uint64_t>, INSTRUMENTED_PHASE_COUNT> phase_ticks{};
+    array<atomic<uint64_t>, INSTRUMENTED_PHASE_COUNT> phase_counts{};
+    array<atomic<uint64_t>, INSTRUMENTED_COUNTER_COUNT> counters{};
+};
+
+AtomicTotals totals;
+thread_local InstrumentationTrace last_trace;
+
+double GetNanosecondsPerTick() {
+#ifdef INSTRUMENTATION_USES_TSC
+    // Measured once against the steady clock, over 10 ms
+    static const double nanoseconds_per_tick = [] {
+        const auto start = chrono::steady_clock::now();
+        const uint64_t start_ticks = ReadInstrumentationTicks();
+        auto now = start;
+        while (now - start < 10ms) {
+            now = chrono::steady_clock::now();
+        }
+        return chrono::duration<double, nano>(now - start).count() / (ReadInstrumentationTicks() - start_ticks);
+    }();
+    return nanoseconds_per_tick;
+#else
+    using Period = chrono::steady_clock::period;
+    return 1e9 * Period::num / Period::den;
+#endif
+}
+
+chrono::nanoseconds ToTime(uint64_t ticks) {
+    return chrono::nanoseconds(static_cast<int64_t>(ticks * GetNanosecondsPerTick()));
+}
+
+InstrumentationTrace ToTrace(const InstrumentationTicks& ticks, uint64_t total_ticks) {
+    InstrumentationTrace trace;
+    trace.total_time = ToTime(total_ticks);
+    for (size_t phase = 0; phase < INSTRUMENTED_PHASE_COUNT; ++phase) {
+        trace.phase_times[phase] = ToTime(ticks.phase_ticks[phase]);
+    }
+    trace.phase_counts = ticks.phase_counts;
+    trace.counters = ticks.counters;
+    return trace;
+}
+
+void Publish(const InstrumentationTicks& ticks, uint64_t total_ticks) {
+    last_trace = ToTrace(ticks, total_ticks);
+    totals.call_count.fetch_add(1, memory_order_relaxed);
+    totals.total_ticks.fetch_add(total_ticks, memory_order_relaxed);
+    for (size_t phase = 0; phase < INSTRUMENTED_PHASE_COUNT; ++phase) {
+        totals.phase_ticks[phase].fetch_add(ticks.phase_ticks[phase], memory_order_relaxed);
+        totals.phase_counts[phase].fetch_add(ticks.phase_counts[phase], memory_order_relaxed);
+    }
+    for (size_t counter = 0; counter < INSTRUMENTED_COUNTER_COUNT; ++counter) {
+        totals.counters[counter].fetch_add(ticks.counters[counter], memory_order_relaxed);
+    }
+}
+
+}
+
+string_view GetPhaseName(InstrumentedPhase phase) {
+    static constexpr array<string_view, INSTRUMENTED_PHASE_COUNT> NAMES = {
+        "search", "parse_query", "minus_words", "postings", "predicate", "sort", "add_document", "remove_document",
+    };
+    return NAMES.at(static_cast<size_t>(phase));
+}
+
+string_view GetCounterName(InstrumentedCounter counter) {
+    static constexpr array<string_view, INSTRUMENTED_COUNTER_COUNT> NAMES = {
+        "postings_scanned", "documents_scored", "documents_filtered", "postings_added", "postings_removed",
+    };
+    return NAMES.at(static_cast<size_t>(counter));
+}
+
+ostream& operator<<(ostream& out, const InstrumentationTrace& trace) {
+    out << "total_ns "s << trace.total_time.count() << '\n';
+    for (size_t phase = 0; phase < INSTRUMENTED_PHASE_COUNT; ++phase) {
+        const string_view name = GetPhaseName(static_cast<InstrumentedPhase>(phase));
+        out << name << "_ns "s << trace.phase_times[phase].count() << '\n';
+        out << name << "_count "s << trace.phase_counts[phase] << '\n';
+    }
+    for (size_t counter = 0; counter < INSTRUMENTED_COUNTER_COUNT; ++counter) {
+        out << GetCounterName(static_cast<InstrumentedCounter>(counter)) << ' ' << trace.counters[counter] << '\n';
+    }
+    return out;
+}
+
+const InstrumentationTrace& GetLastInstrumentationTrace() {
+    return last_trace;
+}
+
+InstrumentationTotals GetInstrumentationTotals() {
+    InstrumentationTicks ticks;
+    for (size_t phase = 0; phase < INSTRUMENTED_PHASE_COUNT; ++phase) {
+        ticks.phase_ticks[phase] = totals.phase_ticks[phase].load(memory_order_relaxed);
+        ticks.phase_counts[phase] = totals.phase_counts[phase].load(memory_order_relaxed);
+    }
+    for (size_t counter = 0; counter < INSTRUMENTED_COUNTER_COUNT; ++counter) {
+        ticks.counters[counter] = totals.counters[counter].load(memory_order_relaxed);
+    }
+    return { totals.call_count.load(memory_order_relaxed), ToTrace(ticks, totals.total_ticks.load(memory_order_relaxed)) };
+}
+
+void ResetInstrumentationTotals() {
+    totals.call_count = 0;
+    totals.total_ticks = 0;
+    for (size_t phase = 0; phase < INSTRUMENTED_PHASE_COUNT; ++phase) {
+        totals.phase_ticks[phase] = 0;
+        totals.phase_counts[phase] = 0;
+    }
+    for (auto& counter : totals.counters) {
+        counter = 0;
+    }
+}
+
+uint64_t GetInstrumentationClockOverhead() noexcept {
+    static const uint64_t overhead = [] {
+        uint64_t min_overhead = UINT64_MAX;
+        for (int i = 0; i < 1000; ++i) {
+            const uint64_t start = ReadInstrumentationTicks();
+            min_overhead = min(min_overhead, ReadInstrumentationTicks() - start);
+        }
+        return min_overhead;
+    }();
+    return overhead;
+}
+
+void InstrumentationTicks::Add(const InstrumentationTicks& other) noexcept {
+    for (size_t phase = 0; phase < INSTRUMENTED_PHASE_COUNT; ++phase) {
+        phase_ticks[phase] += other.phase_ticks[phase];
+        phase_counts[phase] += other.phase_counts[phase];
+    }
+    for (size_t counter = 0; counter < INSTRUMENTED_COUNTER_COUNT; ++counter) {
+        counters[counter] += other.counters[counter];
+    }
+}
+
+InstrumentedCallScope::InstrumentedCallScope(InstrumentedPhase phase)
+    : phase_(static_cast<int>(phase)) {
+    InstrumentationThreadState& state = instrumentation_thread_state;
+    const uint64_t now = ReadInstrumentationTicks();
+    if (state.ticks) {
+        state.Charge(now);
+        outer_phase_ = state.phase;
+    }
+    else {
+        owns_trace_ = true;
+        start_ = now;
+        state = { this, &ticks_, -1, now };
+    }
+    state.phase = phase_;
+    ++state.ticks->phase_counts[phase_];
+}
+
+InstrumentedCallScope::~InstrumentedCallScope() {
+    InstrumentationThreadState& state = instrumentation_thread_state;
+    const uint64_t now = ReadInstrumentationTicks();
+    state.Charge(now);
+    if (!owns_trace_) {
+        state.phase = outer_phase_;
+        return;
+    }
+    state = {};
+    // The parallel parts have finished, so no task adds anything anymore
+    ticks_.Add(task_ticks_);
+    Publish(ticks_, now - start_);
+}
+
+void InstrumentedCallScope::AddTask(const InstrumentationTicks& ticks) {
+    lock_guard lock(task_mutex_);
+    task_ticks_.Add(ticks);
+}
+
+InstrumentedTaskScope::InstrumentedTaskScope(InstrumentedCallScope* call) noexcept
+    : call_(call) {
+    if (!call_) {
+        return;
+    }
+    InstrumentationThreadState& state = instrumentation_thread_state;
+    const uint64_t now = ReadInstrumentationTicks();
+    // The thread may be running the task while it waits inside this or another call
+    state.Charge(now);
+    outer_state_ = state;
+    // Time of the task outside any phase goes to the phase of the call
+    state = { call_, &ticks_, call_->phase_, now };
+}
+
+InstrumentedTaskScope::~InstrumentedTaskScope() {
+    if (!call_) {
+        return;
+    }
+    InstrumentationThreadState& state = instrumentation_thread_state;
+    const uint64_t now = ReadInstrumentationTicks();
+    state.Charge(now);
+    call_->AddTask(ticks_);
+    state = outer_state_;
+    state.phase_start = now;
+}
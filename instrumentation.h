@@ -0,0 +1,276 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+
+#if defined(SEARCH_SERVER_INSTRUMENTATION) && (defined(__x86_64__) || defined(_M_X64))
+#define INSTRUMENTATION_USES_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Phase timers and counters of SearchServer. They are compiled in only when
+// SEARCH_SERVER_INSTRUMENTATION is defined for the whole build; otherwise the INSTRUMENT_
+// macros expand to nothing and the traces below stay empty.
+//
+// Every public call of SearchServer collects a trace on its thread. Phase times are
+// exclusive: a phase inside another pauses it, so the phases of a call add up to its time.
+// Work that a parallel call hands to other threads is added to its trace as well, so its
+// phases may add up to more than its wall time.
+enum class InstrumentedPhase {
+    // Searches outside the phases below: IDFs, ranges, the result cache
+    SEARCH,
+    PARSE_QUERY,
+    MINUS_WORDS,
+    // Postings of the plus words, without the predicate
+    POSTINGS,
+    PREDICATE,
+    // Picking the best documents and ordering them
+    SORT,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    COUNT,
+};
+
+enum class InstrumentedCounter {
+    POSTINGS_SCANNED,
+    DOCUMENTS_SCORED,
+    // Rejected by the predicate. Status filters skip documents by their bitmaps instead,
+    // uncounted
+    DOCUMENTS_FILTERED,
+    POSTINGS_ADDED,
+    POSTINGS_REMOVED,
+    COUNT,
+};
+
+constexpr size_t INSTRUMENTED_PHASE_COUNT = static_cast<size_t>(InstrumentedPhase::COUNT);
+constexpr size_t INSTRUMENTED_COUNTER_COUNT = static_cast<size_t>(InstrumentedCounter::COUNT);
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+constexpr bool INSTRUMENTATION_ENABLED = true;
+#else
+constexpr bool INSTRUMENTATION_ENABLED = false;
+#endif
+
+struct InstrumentationTrace {
+    // Wall time of the calls on their threads
+    std::chrono::nanoseconds total_time{};
+    std::array<std::chrono::nanoseconds, INSTRUMENTED_PHASE_COUNT> phase_times{};
+    // Times each phase was entered
+    std::array<uint64_t, INSTRUMENTED_PHASE_COUNT> phase_counts{};
+    std::array<uint64_t, INSTRUMENTED_COUNTER_COUNT> counters{};
+
+    std::chrono::nanoseconds GetTime(InstrumentedPhase phase) const noexcept {
+        return phase_times[static_cast<size_t>(phase)];
+    }
+
+    uint64_t GetCount(InstrumentedCounter counter) const noexcept {
+        return counters[static_cast<size_t>(counter)];
+    }
+};
+
+struct InstrumentationTotals {
+    uint64_t call_count = 0;
+    // Sums over the calls
+    InstrumentationTrace trace;
+};
+
+std::string_view GetPhaseName(InstrumentedPhase phase);
+std::string_view GetCounterName(InstrumentedCounter counter);
+
+// One "name value" line per phase time in ns and per counter
+std::ostream& operator<<(std::ostream& out, const InstrumentationTrace& trace);
+
+// Trace of the last call that finished on this thread
+const InstrumentationTrace& GetLastInstrumentationTrace();
+
+// Sums over the calls finished on all threads since the start or the last reset
+InstrumentationTotals GetInstrumentationTotals();
+void ResetInstrumentationTotals();
+
+// Raw per-phase ticks, converted to time when a call finishes
+struct InstrumentationTicks {
+    std::array<uint64_t, INSTRUMENTED_PHASE_COUNT> phase_ticks{};
+    std::array<uint64_t, INSTRUMENTED_PHASE_COUNT> phase_counts{};
+    std::array<uint64_t, INSTRUMENTED_COUNTER_COUNT> counters{};
+
+    void Add(const InstrumentationTicks& other) noexcept;
+};
+
+// Time stamp counter where there is one: a couple of nanoseconds per read
+inline uint64_t ReadInstrumentationTicks() noexcept {
+#ifdef INSTRUMENTATION_USES_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Ticks between two back-to-back reads, measured once
+uint64_t GetInstrumentationClockOverhead() noexcept;
+
+class InstrumentedCallScope;
+
+// What the measurements of this thread go to
+struct InstrumentationThreadState {
+    InstrumentedCallScope* call = nullptr;
+    InstrumentationTicks* ticks = nullptr;
+    int phase = -1;
+    // Sampled phases move it forward, so it may lie ahead of the clock
+    uint64_t phase_start = 0;
+    uint32_t sample_counter = 0;
+
+    // Charges the time since phase_start to the current phase
+    void Charge(uint64_t now) noexcept {
+        if (phase >= 0 && now > phase_start) {
+            ticks->phase_ticks[phase] += now - phase_start;
+        }
+        phase_start = now;
+    }
+};
+
+inline thread_local InstrumentationThreadState instrumentation_thread_state;
+
+inline void AddInstrumentedCount(InstrumentedCounter counter, uint64_t count) noexcept {
+    if (instrumentation_thread_state.ticks) {
+        instrumentation_thread_state.ticks->counters[static_cast<size_t>(counter)] += count;
+    }
+}
+
+class InstrumentedPhaseScope {
+public:
+    explicit InstrumentedPhaseScope(InstrumentedPhase phase) noexcept {
+        InstrumentationThreadState& state = instrumentation_thread_state;
+        if (!state.ticks) {
+            return;
+        }
+        active_ = true;
+        state.Charge(ReadInstrumentationTicks());
+        outer_phase_ = state.phase;
+        state.phase = static_cast<int>(phase);
+        ++state.ticks->phase_counts[state.phase];
+    }
+
+    ~InstrumentedPhaseScope() {
+        if (active_) {
+            InstrumentationThreadState& state = instrumentation_thread_state;
+            state.Charge(ReadInstrumentationTicks());
+            state.phase = outer_phase_;
+        }
+    }
+
+    InstrumentedPhaseScope(const InstrumentedPhaseScope&) = delete;
+    InstrumentedPhaseScope& operator=(const InstrumentedPhaseScope&) = delete;
+
+private:
+    bool active_ = false;
+    int outer_phase_ = -1;
+};
+
+// Times one in SAMPLE_PERIOD entries and charges it SAMPLE_PERIOD times, for phases entered
+// once per document, where reading the clock costs more than the phase. The estimate is
+// taken off the enclosing phase, which has run all of the entries
+class InstrumentedSampledPhaseScope {
+public:
+    static constexpr uint32_t SAMPLE_PERIOD = 32;
+
+    explicit InstrumentedSampledPhaseScope(InstrumentedPhase phase) noexcept {
+        InstrumentationThreadState& state = instrumentation_thread_state;
+        if (!state.ticks) {
+            return;
+        }
+        ++state.ticks->phase_counts[static_cast<size_t>(phase)];
+        if (++state.sample_counter % SAMPLE_PERIOD == 0) {
+            phase_ = static_cast<int>(phase);
+            start_ = ReadInstrumentationTicks();
+        }
+    }
+
+    ~InstrumentedSampledPhaseScope() {
+        if (phase_ >= 0) {
+            InstrumentationThreadState& state = instrumentation_thread_state;
+            const uint64_t elapsed = ReadInstrumentationTicks() - start_;
+            const uint64_t overhead = GetInstrumentationClockOverhead();
+            const uint64_t estimate = (elapsed > overhead ? elapsed - overhead : 0) * SAMPLE_PERIOD;
+            state.ticks->phase_ticks[phase_] += estimate;
+            state.phase_start += estimate;
+        }
+    }
+
+    InstrumentedSampledPhaseScope(const InstrumentedSampledPhaseScope&) = delete;
+    InstrumentedSampledPhaseScope& operator=(const InstrumentedSampledPhaseScope&) = delete;
+
+private:
+    int phase_ = -1;
+    uint64_t start_ = 0;
+};
+
+// Starts a trace if the thread has none yet; inside another call it is just a phase
+class InstrumentedCallScope {
+public:
+    explicit InstrumentedCallScope(InstrumentedPhase phase);
+    ~InstrumentedCallScope();
+
+    InstrumentedCallScope(const InstrumentedCallScope&) = delete;
+    InstrumentedCallScope& operator=(const InstrumentedCallScope&) = delete;
+
+    static InstrumentedCallScope* GetCurrent() noexcept {
+        return instrumentation_thread_state.call;
+    }
+
+private:
+    friend class InstrumentedTaskScope;
+
+    int phase_;
+    bool owns_trace_ = false;
+    uint64_t start_ = 0;
+    InstrumentationTicks ticks_;
+    // Measurements of tasks, which may run on other threads
+    std::mutex task_mutex_;
+    InstrumentationTicks task_ticks_;
+    int outer_phase_ = -1;
+
+    void AddTask(const InstrumentationTicks& ticks);
+};
+
+// Part of a call run as a task, maybe on another thread; call may be null
+class InstrumentedTaskScope {
+public:
+    explicit InstrumentedTaskScope(InstrumentedCallScope* call) noexcept;
+    ~InstrumentedTaskScope();
+
+    InstrumentedTaskScope(const InstrumentedTaskScope&) = delete;
+    InstrumentedTaskScope& operator=(const InstrumentedTaskScope&) = delete;
+
+private:
+    InstrumentedCallScope* call_;
+    InstrumentationThreadState outer_state_;
+    InstrumentationTicks ticks_;
+};
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+#define INSTRUMENTATION_JOIN_NAME(prefix, line) prefix##line
+#define INSTRUMENTATION_NAME(prefix, line) INSTRUMENTATION_JOIN_NAME(prefix, line)
+#define INSTRUMENT_CALL(phase) InstrumentedCallScope INSTRUMENTATION_NAME(instrumented_call_, __LINE__)(InstrumentedPhase::phase)
+#define INSTRUMENT_PHASE(phase) InstrumentedPhaseScope INSTRUMENTATION_NAME(instrumented_phase_, __LINE__)(InstrumentedPhase::phase)
+#define INSTRUMENT_SAMPLED_PHASE(phase) InstrumentedSampledPhaseScope INSTRUMENTATION_NAME(instrumented_phase_, __LINE__)(InstrumentedPhase::phase)
+#define INSTRUMENT_COUNT(counter, count) AddInstrumentedCount(InstrumentedCounter::counter, (count))
+// Tasks of a parallel part name the call they belong to
+#define INSTRUMENT_CAPTURE_CALL(name) InstrumentedCallScope* const name = InstrumentedCallScope::GetCurrent()
+#define INSTRUMENT_TASK(call) InstrumentedTaskScope INSTRUMENTATION_NAME(instrumented_task_, __LINE__)(call)
+#else
+#define INSTRUMENT_CALL(phase)
+#define INSTRUMENT_PHASE(phase)
+#define INSTRUMENT_SAMPLED_PHASE(phase)
+#define INSTRUMENT_COUNT(counter, count)
+#define INSTRUMENT_CAPTURE_CALL(name)
+#define INSTRUMENT_TASK(call)
+#endif
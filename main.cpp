@@ -1,6 +1,31 @@
 ﻿#include <iostream>
+#include <string_view>
+#include "benchmark.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-    std::cout << "Hello World!\n";
+    // "suite" prints only the machine-readable suite
+    if (argc > 1 && std::string_view(argv[1]) == "suite") {
+        BenchmarkSuite(std::cout);
+        return 0;
+    }
+    BenchmarkPostingScan(std::cout);
+    BenchmarkPostingFormats(std::cout);
+    BenchmarkIndexing(std::cout);
+    BenchmarkSnapshot(std::cout);
+    BenchmarkResultCache(std::cout);
+    BenchmarkQueryBatch(std::cout);
+    BenchmarkJoinedResults(std::cout);
+    BenchmarkDeduplication(std::cout);
+    BenchmarkNearDuplicates(std::cout);
+    BenchmarkTokenizer(std::cout);
+    BenchmarkIngestion(std::cout);
+    BenchmarkRequestStatistics(std::cout);
+    BenchmarkInstrumentation(std::cout);
+    BenchmarkRetrievalModes(std::cout);
+    BenchmarkStatusFilter(std::cout);
+    BenchmarkPages(std::cout);
+    BenchmarkCompaction(std::cout);
+    BenchmarkWordFrequencies(std::cout);
+    BenchmarkConcurrentMap(std::cout);
 }
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Estimates of the heap bytes standard containers hold, counting reserved capacity. Node
+// sizes follow the usual 64-bit implementations; allocator rounding isn't counted
+
+// Color and three links of a red-black tree node
+constexpr size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+// Link and cached hash of a hash table node
+constexpr size_t HASH_NODE_OVERHEAD = 2 * sizeof(void*);
+// Counts and virtual table of the control block of make_shared
+constexpr size_t SHARED_CONTROL_BLOCK_SIZE = 2 * sizeof(void*);
+
+inline size_t EstimateMemoryUsage(const std::string& text) noexcept {
+    // Short strings live inside the object
+    return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+}
+
+template <typename T>
+size_t EstimateMemoryUsage(const std::vector<T>& items) noexcept {
+    return items.capacity() * sizeof(T);
+}
+
+template <typename Key, typename Value, typename Compare>
+size_t EstimateMemoryUsage(const std::map<Key, Value, Compare>& items) noexcept {
+    return items.size() * (TREE_NODE_OVERHEAD + sizeof(typename std::map<Key, Value, Compare>::value_type));
+}
+
+template <typename Compare>
+size_t EstimateMemoryUsage(const std::set<std::string, Compare>& items) noexcept {
+    size_t usage = items.size() * (TREE_NODE_OVERHEAD + sizeof(std::string));
+    for (const std::string& item : items) {
+        usage += EstimateMemoryUsage(item);
+    }
+    return usage;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+size_t EstimateMemoryUsage(const std::unordered_map<Key, Value, Hash, Equal>& items) noexcept {
+    return items.size() * (HASH_NODE_OVERHEAD + sizeof(typename std::unordered_map<Key, Value, Hash, Equal>::value_type))
+        + items.bucket_count() * sizeof(void*);
+}
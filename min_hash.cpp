@@ -0,0 +1,63 @@
+#include "min_hash.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+    return x ^ (x >> 31);
+}
+
+// Hash function i is the multiply-shift hash (a_i * x + b_i) >> 32 of the mixed term id,
+// with odd a_i: one multiply-add per term and function
+struct HashParameters {
+    array<uint64_t, MIN_HASH_SIZE> multipliers;
+    array<uint64_t, MIN_HASH_SIZE> increments;
+};
+
+constexpr HashParameters MakeHashParameters() {
+    HashParameters parameters{};
+    uint64_t state = 0x5DEECE66D;
+    for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+        parameters.multipliers[i] = Mix(state += 0x9E3779B97F4A7C15) | 1;
+        parameters.increments[i] = Mix(state += 0x9E3779B97F4A7C15);
+    }
+    return parameters;
+}
+
+constexpr HashParameters HASH_PARAMETERS = MakeHashParameters();
+
+}
+
+void ComputeMinHash(span<const int> term_ids, span<uint32_t> signature) {
+    fill(signature.begin(), signature.end(), numeric_limits<uint32_t>::max());
+    for (const int term_id : term_ids) {
+        const uint64_t term = Mix(static_cast<uint32_t>(term_id));
+        for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+            const auto hash = static_cast<uint32_t>((HASH_PARAMETERS.multipliers[i] * term + HASH_PARAMETERS.increments[i]) >> 32);
+            signature[i] = min(signature[i], hash);
+        }
+    }
+}
+
+double EstimateJaccard(span<const uint32_t> lhs, span<const uint32_t> rhs) {
+    size_t equal_count = 0;
+    for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+        equal_count += lhs[i] == rhs[i];
+    }
+    return static_cast<double>(equal_count) / MIN_HASH_SIZE;
+}
+
+uint64_t HashMinHashBand(span<const uint32_t> signature, size_t band) {
+    uint64_t hash = band;
+    for (size_t row = band * MIN_HASH_BAND_ROWS; row < (band + 1) * MIN_HASH_BAND_ROWS; ++row) {
+        hash = Mix(hash ^ signature[row]);
+    }
+    return hash;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// MinHash signatures of term id sets. Entry i of a signature is the minimum of the i-th
+// hash function over the set, so two signatures agree in an entry with probability equal
+// to the Jaccard similarity of their sets. For locality-sensitive hashing a signature is
+// cut into MIN_HASH_BAND_COUNT bands: sets sharing a whole band become candidates, which
+// happens with probability 1 - (1 - J^rows)^bands, about 1/2 at J = 0.5 and 0.99 at J = 0.8.
+constexpr size_t MIN_HASH_SIZE = 64;
+constexpr size_t MIN_HASH_BAND_COUNT = 16;
+constexpr size_t MIN_HASH_BAND_ROWS = MIN_HASH_SIZE / MIN_HASH_BAND_COUNT;
+
+// signature must have MIN_HASH_SIZE entries; an empty set gets all entries UINT32_MAX
+void ComputeMinHash(std::span<const int> term_ids, std::span<uint32_t> signature);
+
+// Share of equal entries
+double EstimateJaccard(std::span<const uint32_t> lhs, std::span<const uint32_t> rhs);
+
+uint64_t HashMinHashBand(std::span<const uint32_t> signature, size_t band);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Read-only set of document ordinals, one bit per ordinal, over words owned elsewhere.
+// Ordinals past the words aren't in the set
+class OrdinalBitmap {
+public:
+    static constexpr int WORD_BITS = 64;
+
+    OrdinalBitmap() = default;
+
+    explicit OrdinalBitmap(std::span<const uint64_t> words) noexcept
+        : words_(words) {
+    }
+
+    bool Contains(int ordinal) const noexcept {
+        const size_t word = static_cast<size_t>(ordinal) / WORD_BITS;
+        return word < words_.size() && (words_[word] >> (ordinal % WORD_BITS) & 1) != 0;
+    }
+
+    static size_t GetWordCount(int ordinal_count) noexcept {
+        return (static_cast<size_t>(ordinal_count) + WORD_BITS - 1) / WORD_BITS;
+    }
+
+private:
+    std::span<const uint64_t> words_;
+};
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <vector>
+
+// Slices a sequence that is already in memory. To page through search results without
+// finding all of them, see SearchServer::FindDocumentsPage
 
 template <typename Iterator>
 class IteratorRange {
@@ -8,7 +14,7 @@ public:
     IteratorRange(Iterator begin, Iterator end)
         : first_(begin)
         , last_(end)
-        , size_(distance(first_, last_)) {
+        , size_(std::distance(first_, last_)) {
     }
 
     Iterator begin() const {
@@ -34,9 +40,9 @@ template <typename Iterator>
 class Paginator {
 public:
     Paginator(Iterator begin, Iterator end, size_t page_size) {
-        for (size_t left = distance(begin, end); left > 0;) {
-            const size_t current_page_size = min(page_size, left);
-            const Iterator current_page_end = next(begin, current_page_size);
+        for (size_t left = std::distance(begin, end); left > 0;) {
+            const size_t current_page_size = std::min(page_size, left);
+            const Iterator current_page_end = std::next(begin, current_page_size);
             pages_.push_back({ begin, current_page_end });
 
             left -= current_page_size;
@@ -57,7 +63,7 @@ public:
     }
 
 private:
-    vector<IteratorRange<Iterator>> pages_;
+    std::vector<IteratorRange<Iterator>> pages_;
 };
 
 template <typename Iterator>
@@ -70,5 +76,5 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
 
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
-    return Paginator(begin(c), end(c), page_size);
+    return Paginator(std::begin(c), std::end(c), page_size);
 }
@@ -0,0 +1,489 @@
+#include "posting_list.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+PostingList::PostingList(PostingFormat format)
+    : format_(format) {
+}
+
+void PostingList::Add(int document_id, double term_freq) {
+    max_term_freq_ = max(max_term_freq_, term_freq);
+    if (format_ == PostingFormat::FLAT && (document_ids_.empty() || document_ids_.back() < document_id)) {
+        if (document_ids_.size() % BLOCK_SIZE == 0) {
+            block_max_term_freqs_.push_back(term_freq);
+        }
+        else {
+            block_max_term_freqs_.back() = max(block_max_term_freqs_.back(), term_freq);
+        }
+        document_ids_.push_back(document_id);
+        term_freqs_.push_back(term_freq);
+    }
+    else {
+        pending_.emplace_back(document_id, term_freq);
+    }
+}
+
+void PostingList::Flush() {
+    if (pending_.empty()) {
+        return;
+    }
+    sort(pending_.begin(), pending_.end());
+    if (format_ == PostingFormat::COMPRESSED) {
+        FlushCompressed();
+        return;
+    }
+
+    // Merge from the back so that both arrays are extended in place
+    const size_t first_moved = lower_bound(document_ids_.begin(), document_ids_.end(), pending_.front().first) - document_ids_.begin();
+    size_t main_left = document_ids_.size();
+    size_t pending_left = pending_.size();
+    size_t out = main_left + pending_left;
+    document_ids_.resize(out);
+    term_freqs_.resize(out);
+    while (pending_left > 0) {
+        --out;
+        if (main_left > 0 && document_ids_[main_left - 1] > pending_[pending_left - 1].first) {
+            --main_left;
+            document_ids_[out] = document_ids_[main_left];
+            term_freqs_[out] = term_freqs_[main_left];
+        }
+        else {
+            --pending_left;
+            document_ids_[out] = pending_[pending_left].first;
+            term_freqs_[out] = pending_[pending_left].second;
+        }
+    }
+    pending_.clear();
+    UpdateFlatBlockMaxima(first_moved / BLOCK_SIZE);
+}
+
+bool PostingList::Erase(int document_id) {
+    if (format_ == PostingFormat::COMPRESSED) {
+        return EraseCompressed(document_id);
+    }
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return false;
+    }
+    const auto index = it - document_ids_.begin();
+    document_ids_.erase(it);
+    term_freqs_.erase(term_freqs_.begin() + index);
+    UpdateFlatBlockMaxima(index / BLOCK_SIZE);
+    return true;
+}
+
+size_t PostingList::EraseAll(span<const int> document_ids) {
+    if (format_ == PostingFormat::COMPRESSED) {
+        vector<pair<int, double>> postings;
+        DecodeAll(postings);
+        const size_t old_size = postings.size();
+        auto removed = document_ids.begin();
+        erase_if(postings, [&](const pair<int, double>& posting) {
+            removed = lower_bound(removed, document_ids.end(), posting.first);
+            return removed != document_ids.end() && *removed == posting.first;
+        });
+        blocks_.clear();
+        block_max_term_freqs_.clear();
+        packed_deltas_.clear();
+        quantized_freqs_.clear();
+        EncodeAll(postings);
+        return old_size - postings.size();
+    }
+    size_t out = 0;
+    size_t first_moved = document_ids_.size();
+    auto removed = document_ids.begin();
+    for (size_t i = 0; i < document_ids_.size(); ++i) {
+        removed = lower_bound(removed, document_ids.end(), document_ids_[i]);
+        if (removed != document_ids.end() && *removed == document_ids_[i]) {
+            first_moved = min(first_moved, i);
+            continue;
+        }
+        document_ids_[out] = document_ids_[i];
+        term_freqs_[out] = term_freqs_[i];
+        ++out;
+    }
+    const size_t erased_count = document_ids_.size() - out;
+    document_ids_.resize(out);
+    term_freqs_.resize(out);
+    UpdateFlatBlockMaxima(first_moved / BLOCK_SIZE);
+    return erased_count;
+}
+
+bool PostingList::Contains(int document_id) const {
+    if (format_ == PostingFormat::FLAT) {
+        const span<const int> document_ids = GetDocumentIds();
+        return binary_search(document_ids.begin(), document_ids.end(), document_id);
+    }
+    const span<const Block> blocks = GetBlocks();
+    const auto it = lower_bound(blocks.begin(), blocks.end(), document_id,
+        [](const Block& block, int id) {
+            return block.last_document_id < id;
+        });
+    if (it == blocks.end() || it->first_document_id > document_id) {
+        return false;
+    }
+    int document_ids[BLOCK_SIZE];
+    DecodeBlock(*it, document_ids);
+    return binary_search(document_ids, document_ids + it->count, document_id);
+}
+
+size_t PostingList::GetMemoryUsage() const noexcept {
+    return document_ids_.capacity() * sizeof(int)
+        + term_freqs_.capacity() * sizeof(double)
+        + pending_.capacity() * sizeof(pair<int, double>)
+        + block_max_term_freqs_.capacity() * sizeof(double)
+        + blocks_.capacity() * sizeof(Block)
+        + packed_deltas_.capacity() * sizeof(uint32_t)
+        + quantized_freqs_.capacity() * sizeof(uint16_t);
+}
+
+void PostingList::Compact(span<const int> new_document_ids) {
+    Flush();
+    if (format_ == PostingFormat::COMPRESSED) {
+        vector<pair<int, double>> postings;
+        DecodeAll(postings);
+        if (!new_document_ids.empty()) {
+            for (auto& [document_id, term_freq] : postings) {
+                document_id = new_document_ids[document_id];
+            }
+        }
+        blocks_ = {};
+        block_max_term_freqs_ = {};
+        packed_deltas_ = {};
+        quantized_freqs_ = {};
+        max_term_freq_ = 0.0;
+        EncodeAll(postings);
+    }
+    else {
+        if (!new_document_ids.empty()) {
+            for (int& document_id : document_ids_) {
+                document_id = new_document_ids[document_id];
+            }
+        }
+        max_term_freq_ = block_max_term_freqs_.empty() ? 0.0 : *max_element(block_max_term_freqs_.begin(), block_max_term_freqs_.end());
+    }
+    document_ids_.shrink_to_fit();
+    term_freqs_.shrink_to_fit();
+    pending_.shrink_to_fit();
+    block_max_term_freqs_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+    packed_deltas_.shrink_to_fit();
+    quantized_freqs_.shrink_to_fit();
+}
+
+void PostingList::Save(SnapshotWriter& writer) const {
+    writer.WriteValue(static_cast<uint32_t>(format_));
+    writer.WriteValue(max_term_freq_);
+    writer.WriteArray(GetDocumentIds());
+    writer.WriteArray(GetTermFreqs());
+    writer.WriteArray(GetBlockMaxTermFreqs());
+    writer.WriteArray(GetBlocks());
+    writer.WriteArray(GetPackedDeltas());
+    writer.WriteArray(GetQuantizedFreqs());
+}
+
+PostingList PostingList::Load(SnapshotReader& reader) {
+    PostingList list(static_cast<PostingFormat>(reader.ReadValue<uint32_t>()));
+    list.max_term_freq_ = reader.ReadValue<double>();
+    list.is_mapped_ = true;
+    list.mapped_.document_ids = reader.ReadArray<int>();
+    list.mapped_.term_freqs = reader.ReadArray<double>();
+    list.mapped_.block_max_term_freqs = reader.ReadArray<double>();
+    list.mapped_.blocks = reader.ReadArray<Block>();
+    list.mapped_.packed_deltas = reader.ReadArray<uint32_t>();
+    list.mapped_.quantized_freqs = reader.ReadArray<uint16_t>();
+    return list;
+}
+
+void PostingList::Validate(int document_count) const {
+    const auto check = [](bool condition) {
+        if (!condition) {
+            throw invalid_argument("snapshot posting list is inconsistent"s);
+        }
+    };
+    const span<const int> document_ids = GetDocumentIds();
+    const span<const Block> blocks = GetBlocks();
+    const span<const uint32_t> packed_deltas = GetPackedDeltas();
+    const span<const uint16_t> quantized_freqs = GetQuantizedFreqs();
+    if (format_ == PostingFormat::FLAT) {
+        check(blocks.empty() && packed_deltas.empty() && quantized_freqs.empty());
+        check(GetTermFreqs().size() == document_ids.size());
+        check((document_ids.size() + BLOCK_SIZE - 1) / BLOCK_SIZE == GetBlockMaxTermFreqs().size());
+        check(document_ids.empty() || (document_ids.front() >= 0 && document_ids.back() < document_count));
+        check(adjacent_find(document_ids.begin(), document_ids.end(), greater_equal<>()) == document_ids.end());
+        return;
+    }
+    check(format_ == PostingFormat::COMPRESSED);
+    check(document_ids.empty() && GetTermFreqs().empty() && blocks.size() == GetBlockMaxTermFreqs().size());
+    int64_t previous_last = -1;
+    for (const Block& block : blocks) {
+        check(block.count > 0 && block.count <= BLOCK_SIZE && block.bit_width <= 32);
+        check(block.first_document_id > previous_last && block.last_document_id < document_count);
+        check(uint64_t{ block.posting_offset } + block.count <= quantized_freqs.size());
+        // The words PackDeltas wrote, DecodeBlock's trailing one included
+        const uint64_t word_count = ((block.count - 1) * size_t{ block.bit_width } + 31) / 32 + 1;
+        check(uint64_t{ block.word_offset } + word_count <= packed_deltas.size());
+        // Decoded here in 64 bits, so that no delta can overflow an id
+        const uint32_t* words = packed_deltas.data() + block.word_offset;
+        const uint64_t mask = (uint64_t{ 1 } << block.bit_width) - 1;
+        int64_t document_id = block.first_document_id;
+        size_t bit = 0;
+        for (size_t i = 1; i < block.count; ++i, bit += block.bit_width) {
+            const size_t word = bit / 32;
+            const uint64_t window = words[word] | (uint64_t{ words[word + 1] } << 32);
+            const uint64_t delta = (window >> (bit % 32)) & mask;
+            check(delta > 0);
+            document_id += static_cast<int64_t>(delta);
+            check(document_id <= block.last_document_id);
+        }
+        check(document_id == block.last_document_id);
+        previous_last = block.last_document_id;
+    }
+}
+
+void PostingList::UpdateFlatBlockMaxima(size_t first_block) {
+    block_max_term_freqs_.resize((term_freqs_.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    for (size_t block = first_block; block < block_max_term_freqs_.size(); ++block) {
+        const auto first = term_freqs_.begin() + block * BLOCK_SIZE;
+        block_max_term_freqs_[block] = *max_element(first, first + min(BLOCK_SIZE, term_freqs_.size() - block * BLOCK_SIZE));
+    }
+}
+
+void PostingList::FlushCompressed() {
+    vector<pair<int, double>> postings;
+    if (blocks_.empty() || pending_.front().first > blocks_.back().last_document_id) {
+        // Appending: only the last block is reopened, and only if it has room
+        if (!blocks_.empty() && blocks_.back().count < BLOCK_SIZE) {
+            const Block last = blocks_.back();
+            int document_ids[BLOCK_SIZE];
+            DecodeBlock(last, document_ids);
+            for (size_t i = 0; i < last.count; ++i) {
+                postings.emplace_back(document_ids[i], quantized_freqs_[last.posting_offset + i] * TERM_FREQ_STEP);
+            }
+            blocks_.pop_back();
+            block_max_term_freqs_.pop_back();
+            packed_deltas_.resize(last.word_offset);
+            quantized_freqs_.resize(last.posting_offset);
+        }
+        postings.insert(postings.end(), pending_.begin(), pending_.end());
+    }
+    else {
+        vector<pair<int, double>> encoded;
+        DecodeAll(encoded);
+        postings.reserve(encoded.size() + pending_.size());
+        merge(encoded.begin(), encoded.end(), pending_.begin(), pending_.end(), back_inserter(postings));
+        blocks_.clear();
+        block_max_term_freqs_.clear();
+        packed_deltas_.clear();
+        quantized_freqs_.clear();
+    }
+    EncodeAll(postings);
+    pending_.clear();
+}
+
+bool PostingList::EraseCompressed(int document_id) {
+    const auto it = lower_bound(blocks_.begin(), blocks_.end(), document_id,
+        [](const Block& block, int id) {
+            return block.last_document_id < id;
+        });
+    if (it == blocks_.end() || it->first_document_id > document_id) {
+        return false;
+    }
+    int document_ids[BLOCK_SIZE];
+    DecodeBlock(*it, document_ids);
+    int* const pos = lower_bound(document_ids, document_ids + it->count, document_id);
+    if (pos == document_ids + it->count || *pos != document_id) {
+        return false;
+    }
+
+    const size_t block_index = it - blocks_.begin();
+    const size_t old_word_count = GetBlockWordCount(block_index);
+    const auto words_begin = packed_deltas_.begin() + it->word_offset;
+    quantized_freqs_.erase(quantized_freqs_.begin() + it->posting_offset + (pos - document_ids));
+
+    vector<uint32_t> words;
+    const bool block_removed = it->count == 1;
+    if (block_removed) {
+        packed_deltas_.erase(words_begin, words_begin + old_word_count);
+        blocks_.erase(it);
+        block_max_term_freqs_.erase(block_max_term_freqs_.begin() + block_index);
+    }
+    else {
+        copy(pos + 1, document_ids + it->count, pos);
+        --it->count;
+        it->first_document_id = document_ids[0];
+        it->last_document_id = document_ids[it->count - 1];
+        it->bit_width = PackDeltas(document_ids, it->count, words);
+        const auto words_end = packed_deltas_.erase(words_begin, words_begin + old_word_count);
+        packed_deltas_.insert(words_end, words.begin(), words.end());
+        const auto freqs = quantized_freqs_.begin() + it->posting_offset;
+        block_max_term_freqs_[block_index] = *max_element(freqs, freqs + it->count) * TERM_FREQ_STEP;
+    }
+
+    const size_t first_shifted = block_removed ? block_index : block_index + 1;
+    for (size_t i = first_shifted; i < blocks_.size(); ++i) {
+        blocks_[i].word_offset = static_cast<uint32_t>(blocks_[i].word_offset + words.size() - old_word_count);
+        --blocks_[i].posting_offset;
+    }
+    return true;
+}
+
+void PostingList::DecodeBlock(const Block& block, int* document_ids) const {
+    const uint32_t* words = GetPackedDeltas().data() + block.word_offset;
+    const uint64_t mask = (uint64_t{ 1 } << block.bit_width) - 1;
+    int document_id = block.first_document_id;
+    document_ids[0] = document_id;
+    size_t bit = 0;
+    for (size_t i = 1; i < block.count; ++i, bit += block.bit_width) {
+        const size_t word = bit / 32;
+        const uint64_t window = words[word] | (uint64_t{ words[word + 1] } << 32);
+        document_id += static_cast<int>((window >> (bit % 32)) & mask);
+        document_ids[i] = document_id;
+    }
+}
+
+void PostingList::DecodeAll(vector<pair<int, double>>& postings) const {
+    postings.reserve(postings.size() + size());
+    ForEach([&postings](int document_id, double term_freq) {
+        postings.emplace_back(document_id, term_freq);
+    });
+}
+
+void PostingList::EncodeAll(const vector<pair<int, double>>& postings) {
+    int document_ids[BLOCK_SIZE];
+    for (size_t first = 0; first < postings.size(); first += BLOCK_SIZE) {
+        const size_t count = min(BLOCK_SIZE, postings.size() - first);
+        for (size_t i = 0; i < count; ++i) {
+            document_ids[i] = postings[first + i].first;
+            quantized_freqs_.push_back(QuantizeTermFreq(postings[first + i].second));
+            // Rounding may have raised it
+            max_term_freq_ = max(max_term_freq_, quantized_freqs_.back() * TERM_FREQ_STEP);
+        }
+        const auto freqs = quantized_freqs_.end() - count;
+        block_max_term_freqs_.push_back(*max_element(freqs, quantized_freqs_.end()) * TERM_FREQ_STEP);
+        Block block;
+        block.first_document_id = document_ids[0];
+        block.last_document_id = document_ids[count - 1];
+        block.word_offset = static_cast<uint32_t>(packed_deltas_.size());
+        block.posting_offset = static_cast<uint32_t>(quantized_freqs_.size() - count);
+        block.count = static_cast<uint8_t>(count);
+        block.bit_width = PackDeltas(document_ids, count, packed_deltas_);
+        blocks_.push_back(block);
+    }
+}
+
+size_t PostingList::GetBlockWordCount(size_t block_index) const {
+    const size_t end = block_index + 1 < blocks_.size() ? blocks_[block_index + 1].word_offset : packed_deltas_.size();
+    return end - blocks_[block_index].word_offset;
+}
+
+uint8_t PostingList::PackDeltas(const int* document_ids, size_t count, vector<uint32_t>& words) {
+    uint32_t max_delta = 0;
+    for (size_t i = 1; i < count; ++i) {
+        max_delta = max(max_delta, static_cast<uint32_t>(document_ids[i] - document_ids[i - 1]));
+    }
+    const int width = bit_width(max_delta);
+
+    // The extra trailing word lets DecodeBlock always read two words at once
+    const size_t offset = words.size();
+    words.resize(offset + ((count - 1) * width + 31) / 32 + 1, 0);
+    size_t bit = 0;
+    for (size_t i = 1; i < count; ++i, bit += width) {
+        const uint64_t delta = uint64_t{ static_cast<uint32_t>(document_ids[i] - document_ids[i - 1]) } << (bit % 32);
+        words[offset + bit / 32] |= static_cast<uint32_t>(delta);
+        words[offset + bit / 32 + 1] |= static_cast<uint32_t>(delta >> 32);
+    }
+    return static_cast<uint8_t>(width);
+}
+
+uint16_t PostingList::QuantizeTermFreq(double term_freq) {
+    const long quantized = lround(term_freq * UINT16_MAX);
+    return static_cast<uint16_t>(clamp(quantized, 1L, static_cast<long>(UINT16_MAX)));
+}
+
+PostingList::Cursor::Cursor(const PostingList& list, int first_document_id)
+    : list_(&list)
+    , document_ids_(list.GetDocumentIds())
+    , term_freqs_(list.GetTermFreqs())
+    , blocks_(list.GetBlocks())
+    , quantized_freqs_(list.GetQuantizedFreqs().data())
+    , block_max_term_freqs_(list.GetBlockMaxTermFreqs()) {
+    if (blocks_.empty()) {
+        index_ = lower_bound(document_ids_.begin(), document_ids_.end(), first_document_id) - document_ids_.begin();
+        document_id_ = index_ < document_ids_.size() ? document_ids_[index_] : END;
+        bound_block_ = index_ / BLOCK_SIZE;
+        return;
+    }
+    EnterBlock(0);
+    SkipTo(first_document_id);
+    bound_block_ = block_index_;
+}
+
+void PostingList::Cursor::SkipTo(int document_id) {
+    if (document_id <= document_id_) {
+        return;
+    }
+    if (blocks_.empty()) {
+        // Galloping: targets are usually close by
+        size_t step = 1;
+        size_t low = index_;
+        size_t high = index_ + 1;
+        while (high < document_ids_.size() && document_ids_[high] < document_id) {
+            low = high;
+            step *= 2;
+            high = index_ + step;
+        }
+        high = min(high, document_ids_.size());
+        index_ = lower_bound(document_ids_.begin() + low, document_ids_.begin() + high, document_id) - document_ids_.begin();
+        document_id_ = index_ < document_ids_.size() ? document_ids_[index_] : END;
+        return;
+    }
+    if (document_id > blocks_[block_index_].last_document_id) {
+        const auto block = lower_bound(blocks_.begin() + block_index_ + 1, blocks_.end(), document_id,
+            [](const Block& block, int id) {
+                return block.last_document_id < id;
+            });
+        EnterBlock(block - blocks_.begin());
+        if (document_id_ == END) {
+            return;
+        }
+    }
+    int* const block_end = block_document_ids_ + blocks_[block_index_].count;
+    index_ = lower_bound(block_document_ids_ + index_, block_end, document_id) - block_document_ids_;
+    document_id_ = block_document_ids_[index_];
+}
+
+void PostingList::Cursor::SkipBoundTo(int document_id) {
+    while (bound_block_ < block_max_term_freqs_.size() && GetBoundLastDocumentId() < document_id) {
+        ++bound_block_;
+    }
+}
+
+int PostingList::Cursor::GetBoundLastDocumentId() const noexcept {
+    if (bound_block_ >= block_max_term_freqs_.size()) {
+        return END;
+    }
+    if (blocks_.empty()) {
+        return document_ids_[min((bound_block_ + 1) * BLOCK_SIZE, document_ids_.size()) - 1];
+    }
+    return blocks_[bound_block_].last_document_id;
+}
+
+void PostingList::Cursor::EnterBlock(size_t block_index) {
+    block_index_ = block_index;
+    index_ = 0;
+    if (block_index_ >= blocks_.size()) {
+        document_id_ = END;
+        return;
+    }
+    list_->DecodeBlock(blocks_[block_index_], block_document_ids_);
+    document_id_ = block_document_ids_[0];
+}
+
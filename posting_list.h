@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+enum class PostingFormat {
+    FLAT,
+    COMPRESSED,
+};
+
+// Postings of a single term sorted by document id.
+//
+// FLAT keeps document ids and term frequencies in two parallel arrays.
+// Documents arriving in ascending order are appended in O(1); out-of-order ones
+// wait in a buffer until Flush() merges them in a single pass.
+//
+// COMPRESSED splits the postings into blocks of up to BLOCK_SIZE documents.
+// Every block stores its first and last document id for skipping, the remaining
+// ids as bit-packed deltas and the term frequencies quantized to 16 bits, which
+// shifts relevance by at most ~1e-5 per word. All additions are buffered and
+// encoded by Flush().
+//
+// Both formats keep the largest term frequency of every block, for FLAT every BLOCK_SIZE
+// postings, so that searches can skip blocks whose documents can't score high enough.
+//
+// Readers must only see flushed lists. Lists loaded from a snapshot read their
+// arrays straight from the mapping and must not be modified.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    class Cursor;
+
+    explicit PostingList(PostingFormat format = PostingFormat::FLAT);
+
+    void Add(int document_id, double term_freq);
+
+    void Flush();
+
+    bool Erase(int document_id);
+
+    // Erases every listed document in one pass over the list; document_ids must be sorted.
+    // Returns how many were found
+    size_t EraseAll(std::span<const int> document_ids);
+
+    bool Contains(int document_id) const;
+
+    size_t size() const noexcept {
+        return GetDocumentIds().size() + GetQuantizedFreqs().size();
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    // At least the largest term frequency of the list, as ForEach reports it. Erasing
+    // postings doesn't lower it, so after removals it may exceed every remaining one
+    double GetMaxTermFreq() const noexcept {
+        return max_term_freq_;
+    }
+
+    // Heap bytes only: a list loaded from a snapshot owns none
+    size_t GetMemoryUsage() const noexcept;
+
+    // Renumbers every document id to new_document_ids[id], which must keep the ids in order;
+    // an empty span keeps them. Also repacks compressed blocks left short by erasures, lowers
+    // GetMaxTermFreq() to the largest remaining frequency and releases spare capacity
+    void Compact(std::span<const int> new_document_ids = {});
+
+    void Save(SnapshotWriter& writer) const;
+    // The mapping behind reader must outlive the list. Call Validate before reading the list
+    static PostingList Load(SnapshotReader& reader);
+    // Throws std::invalid_argument unless the list is well formed: a known format, arrays that
+    // agree in size, blocks within the packed arrays and ids ascending and below document_count
+    void Validate(int document_count) const;
+
+    template <typename Function>
+    void ForEach(Function function) const {
+        const std::span<const Block> blocks = GetBlocks();
+        if (!blocks.empty()) {
+            int document_ids[BLOCK_SIZE];
+            const uint16_t* quantized_freqs = GetQuantizedFreqs().data();
+            for (const Block& block : blocks) {
+                DecodeBlock(block, document_ids);
+                for (size_t i = 0; i < block.count; ++i) {
+                    function(document_ids[i], quantized_freqs[block.posting_offset + i] * TERM_FREQ_STEP);
+                }
+            }
+        }
+        const std::span<const int> document_ids = GetDocumentIds();
+        const std::span<const double> term_freqs = GetTermFreqs();
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            function(document_ids[i], term_freqs[i]);
+        }
+    }
+
+    // Visits postings with first <= document id < last; compressed blocks outside are skipped undecoded
+    template <typename Function>
+    void ForEachInRange(int first, int last, Function function) const {
+        const std::span<const Block> blocks = GetBlocks();
+        if (!blocks.empty()) {
+            int document_ids[BLOCK_SIZE];
+            const uint16_t* quantized_freqs = GetQuantizedFreqs().data();
+            auto block = std::lower_bound(blocks.begin(), blocks.end(), first,
+                [](const Block& block, int id) {
+                    return block.last_document_id < id;
+                });
+            for (; block != blocks.end() && block->first_document_id < last; ++block) {
+                DecodeBlock(*block, document_ids);
+                for (size_t i = 0; i < block->count && document_ids[i] < last; ++i) {
+                    if (document_ids[i] >= first) {
+                        function(document_ids[i], quantized_freqs[block->posting_offset + i] * TERM_FREQ_STEP);
+                    }
+                }
+            }
+        }
+        const std::span<const int> document_ids = GetDocumentIds();
+        const std::span<const double> term_freqs = GetTermFreqs();
+        const auto begin = std::lower_bound(document_ids.begin(), document_ids.end(), first);
+        const auto end = std::lower_bound(begin, document_ids.end(), last);
+        for (auto it = begin; it != end; ++it) {
+            function(*it, term_freqs[it - document_ids.begin()]);
+        }
+    }
+
+private:
+    static constexpr double TERM_FREQ_STEP = 1.0 / UINT16_MAX;
+
+    struct Block {
+        int first_document_id;
+        int last_document_id;
+        uint32_t word_offset;
+        uint32_t posting_offset;
+        uint8_t count;
+        uint8_t bit_width;
+        // Explicit padding, so that saved blocks have no indeterminate bytes
+        uint16_t reserved = 0;
+    };
+
+    PostingFormat format_;
+    double max_term_freq_ = 0.0;
+    // FLAT: the whole list. COMPRESSED: always empty after Flush()
+    std::vector<int> document_ids_;
+    std::vector<double> term_freqs_;
+    std::vector<std::pair<int, double>> pending_;
+    std::vector<double> block_max_term_freqs_;
+    // COMPRESSED only
+    std::vector<Block> blocks_;
+    std::vector<uint32_t> packed_deltas_;
+    std::vector<uint16_t> quantized_freqs_;
+
+    // Arrays of a list loaded from a snapshot, used instead of the vectors above
+    struct MappedArrays {
+        std::span<const int> document_ids;
+        std::span<const double> term_freqs;
+        std::span<const double> block_max_term_freqs;
+        std::span<const Block> blocks;
+        std::span<const uint32_t> packed_deltas;
+        std::span<const uint16_t> quantized_freqs;
+    };
+    bool is_mapped_ = false;
+    MappedArrays mapped_;
+
+    std::span<const int> GetDocumentIds() const noexcept {
+        return is_mapped_ ? mapped_.document_ids : std::span<const int>(document_ids_);
+    }
+
+    std::span<const double> GetTermFreqs() const noexcept {
+        return is_mapped_ ? mapped_.term_freqs : std::span<const double>(term_freqs_);
+    }
+
+    std::span<const double> GetBlockMaxTermFreqs() const noexcept {
+        return is_mapped_ ? mapped_.block_max_term_freqs : std::span<const double>(block_max_term_freqs_);
+    }
+
+    std::span<const Block> GetBlocks() const noexcept {
+        return is_mapped_ ? mapped_.blocks : std::span<const Block>(blocks_);
+    }
+
+    std::span<const uint32_t> GetPackedDeltas() const noexcept {
+        return is_mapped_ ? mapped_.packed_deltas : std::span<const uint32_t>(packed_deltas_);
+    }
+
+    std::span<const uint16_t> GetQuantizedFreqs() const noexcept {
+        return is_mapped_ ? mapped_.quantized_freqs : std::span<const uint16_t>(quantized_freqs_);
+    }
+
+    // Recomputes the maxima of FLAT blocks from first_block on
+    void UpdateFlatBlockMaxima(size_t first_block);
+
+    void FlushCompressed();
+    bool EraseCompressed(int document_id);
+
+    void DecodeBlock(const Block& block, int* document_ids) const;
+    void DecodeAll(std::vector<std::pair<int, double>>& postings) const;
+    void EncodeAll(const std::vector<std::pair<int, double>>& postings);
+    size_t GetBlockWordCount(size_t block_index) const;
+
+    static uint8_t PackDeltas(const int* document_ids, size_t count, std::vector<uint32_t>& words);
+    static uint16_t QuantizeTermFreq(double term_freq);
+};
+
+// Walks a flushed list document by document, for traversals that skip ahead. Compressed
+// blocks are decoded one at a time, and only those the cursor stops in
+class PostingList::Cursor {
+public:
+    // Document id past the last posting
+    static constexpr int END = INT_MAX;
+
+    // Positioned at the first posting with a document id not less than first_document_id
+    Cursor(const PostingList& list, int first_document_id);
+
+    int GetDocumentId() const noexcept {
+        return document_id_;
+    }
+
+    // Only while GetDocumentId() isn't END
+    double GetTermFreq() const noexcept {
+        if (blocks_.empty()) {
+            return term_freqs_[index_];
+        }
+        return quantized_freqs_[blocks_[block_index_].posting_offset + index_] * TERM_FREQ_STEP;
+    }
+
+    void Next() {
+        ++index_;
+        if (blocks_.empty()) {
+            document_id_ = index_ < document_ids_.size() ? document_ids_[index_] : END;
+        }
+        else if (index_ < blocks_[block_index_].count) {
+            document_id_ = block_document_ids_[index_];
+        }
+        else {
+            EnterBlock(block_index_ + 1);
+        }
+    }
+
+    // Moves to the first posting with a document id not less than document_id, never back
+    void SkipTo(int document_id);
+
+    // Moves the bound to the block holding the first posting with a document id not less
+    // than document_id, never back. Decodes nothing and leaves the cursor where it is
+    void SkipBoundTo(int document_id);
+
+    // Largest term frequency in the block of the bound, 0 past the last posting
+    double GetBoundMaxTermFreq() const noexcept {
+        return bound_block_ < block_max_term_freqs_.size() ? block_max_term_freqs_[bound_block_] : 0.0;
+    }
+
+    // Last document id in the block of the bound, END past the last posting
+    int GetBoundLastDocumentId() const noexcept;
+
+private:
+    const PostingList* list_;
+    // FLAT lists
+    std::span<const int> document_ids_;
+    std::span<const double> term_freqs_;
+    // COMPRESSED lists; index_ is then the position in the current block
+    std::span<const Block> blocks_;
+    const uint16_t* quantized_freqs_ = nullptr;
+    size_t block_index_ = 0;
+    int block_document_ids_[BLOCK_SIZE];
+    size_t index_ = 0;
+    int document_id_ = END;
+    std::span<const double> block_max_term_freqs_;
+    size_t bound_block_ = 0;
+
+    void EnterBlock(size_t block_index);
+};
+
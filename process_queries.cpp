@@ -0,0 +1,193 @@
+#include "process_queries.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+using namespace std;
+
+namespace {
+
+// One ProcessQueries call. Lives on the stack of the waiting caller, so the
+// last task touches it only while holding mutex_
+class QueryBatch {
+public:
+    QueryBatch(ThreadPool& pool, size_t query_count, function<void(size_t)> run_query, stop_token stop_token)
+        : pool_(pool)
+        , query_count_(query_count)
+        , run_query_(move(run_query))
+        , stop_token_(move(stop_token)) {
+    }
+
+    void Run(size_t concurrency) {
+        concurrency = min(concurrency, query_count_);
+        if (concurrency == 0) {
+            return;
+        }
+        in_flight_ = concurrency;
+        for (size_t i = 0; i < concurrency; ++i) {
+            pool_.Submit([this] {
+                RunQuery();
+            });
+        }
+        Wait();
+    }
+
+private:
+    ThreadPool& pool_;
+    const size_t query_count_;
+    const function<void(size_t)> run_query_;
+    const stop_token stop_token_;
+
+    atomic<size_t> next_query_ = 0;
+    atomic<size_t> in_flight_ = 0;
+    atomic<bool> failed_ = false;
+    mutex mutex_;
+    condition_variable done_cv_;
+    bool done_ = false;
+    exception_ptr error_;
+
+    bool HasMoreQueries() const {
+        return next_query_.load() < query_count_ && !failed_.load() && !stop_token_.stop_requested();
+    }
+
+    void RunQuery() {
+        const size_t index = next_query_.fetch_add(1);
+        if (index < query_count_ && !failed_.load() && !stop_token_.stop_requested()) {
+            try {
+                run_query_(index);
+            }
+            catch (...) {
+                lock_guard guard(mutex_);
+                if (!error_) {
+                    error_ = current_exception();
+                }
+                failed_ = true;
+            }
+        }
+        // The next query is chained before this one counts as finished, so in_flight_ can't hit zero early
+        if (HasMoreQueries()) {
+            in_flight_.fetch_add(1);
+            pool_.Submit([this] {
+                RunQuery();
+            });
+        }
+        if (in_flight_.fetch_sub(1) == 1) {
+            lock_guard guard(mutex_);
+            done_ = true;
+            done_cv_.notify_all();
+        }
+    }
+
+    void Wait() {
+        unique_lock lock(mutex_);
+        if (pool_.IsWorkerThread()) {
+            // A worker waiting idle could starve the pool, so it runs queued tasks meanwhile
+            while (!done_) {
+                lock.unlock();
+                const bool ran_task = pool_.RunPendingTask();
+                lock.lock();
+                if (!ran_task) {
+                    done_cv_.wait_for(lock, 1ms, [this] {
+                        return done_;
+                    });
+                }
+            }
+        }
+        else {
+            done_cv_.wait(lock, [this] {
+                return done_;
+            });
+        }
+        if (error_) {
+            rethrow_exception(error_);
+        }
+    }
+};
+
+}
+
+void ProcessQueries(
+    ThreadPool& pool,
+    const SearchServer& search_server,
+    const vector<string>& queries,
+    const QueryResultCallback& on_result,
+    QueryBatchOptions options)
+{
+    QueryBatch batch(pool, queries.size(),
+        [&](size_t query_index) {
+            if (!options.statistics) {
+                on_result(query_index, search_server.FindTopDocuments(queries[query_index]));
+                return;
+            }
+            const auto start = RequestStatistics::Clock::now();
+            vector<Document> documents = search_server.FindTopDocuments(queries[query_index]);
+            const auto finish = RequestStatistics::Clock::now();
+            options.statistics->Record(documents.size(), finish - start, finish);
+            on_result(query_index, move(documents));
+        },
+        move(options.stop_token));
+    batch.Run(options.max_concurrency == 0 ? pool.GetThreadCount() : options.max_concurrency);
+}
+
+vector<vector<Document>> ProcessQueries(
+    ThreadPool& pool,
+    const SearchServer& search_server,
+    const vector<string>& queries)
+{
+    vector<vector<Document>> output(queries.size());
+    ProcessQueries(pool, search_server, queries, [&output](size_t query_index, vector<Document> documents) {
+        output[query_index] = move(documents);
+        });
+    return output;
+}
+
+vector<vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const vector<string>& queries)
+{
+    return ProcessQueries(GetDefaultThreadPool(), search_server, queries);
+}
+
+JoinedQueryResults::JoinedQueryResults(vector<Document> documents, vector<size_t> offsets)
+    : documents_(move(documents))
+    , offsets_(move(offsets)) {
+}
+
+JoinedQueryResults ProcessQueriesJoined(
+    ThreadPool& pool,
+    const SearchServer& search_server,
+    const vector<string>& queries)
+{
+    const size_t slot_count = MAX_RESULT_DOCUMENT_COUNT;
+    vector<Document> documents(queries.size() * slot_count);
+    vector<size_t> offsets(queries.size() + 1, 0);
+    QueryBatch batch(pool, queries.size(),
+        [&](size_t query_index) {
+            const span<Document> slots(documents.data() + query_index * slot_count, slot_count);
+            // Counts go one position ahead, where the prefix sum below expects them
+            offsets[query_index + 1] = search_server.WriteTopDocuments(queries[query_index], slots);
+        },
+        {});
+    batch.Run(pool.GetThreadCount());
+
+    // Query i moves from i * slot_count down to offsets[i], never past slots yet to be read
+    for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+        const size_t count = offsets[query_index + 1];
+        offsets[query_index + 1] = offsets[query_index] + count;
+        if (offsets[query_index] != query_index * slot_count) {
+            const auto slots = documents.begin() + query_index * slot_count;
+            copy(slots, slots + count, documents.begin() + offsets[query_index]);
+        }
+    }
+    documents.resize(offsets.back());
+    return { move(documents), move(offsets) };
+}
+
+JoinedQueryResults ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const vector<string>& queries)
+{
+    return ProcessQueriesJoined(GetDefaultThreadPool(), search_server, queries);
+}
@@ -1,33 +1,98 @@
 #pragma once
 #include "search_server.h"
-#include <execution>
-#include <list>
+#include "request_statistics.h"
+#include "thread_pool.h"
+#include <functional>
+#include <ranges>
+#include <span>
+#include <stop_token>
+
+// Receives a finished query: its index in the batch and its results
+using QueryResultCallback = std::function<void(size_t query_index, std::vector<Document> documents)>;
+
+struct QueryBatchOptions {
+    // Queries of the batch running at once; 0 means one per worker of the pool
+    size_t max_concurrency = 0;
+    // Queries not started yet when a stop is requested are skipped
+    std::stop_token stop_token;
+    // When set, every query records its latency and result count here, on its worker
+    RequestStatistics* statistics = nullptr;
+};
+
+// Runs the queries on the pool and hands each result to on_result as soon as its query
+// finishes, on the worker that ran it, so on_result may be called concurrently. A query
+// finishing starts the next one, which keeps at most max_concurrency of them in flight.
+// Blocks until the batch is drained; the first exception thrown by a query stops the batch
+// and is rethrown then
+void ProcessQueries(
+    ThreadPool& pool,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const QueryResultCallback& on_result,
+    QueryBatchOptions options = {});
 
 std::vector<std::vector<Document>> ProcessQueries(
+    ThreadPool& pool,
     const SearchServer& search_server,
-    const std::vector<std::string>& queries)
-{
-    std::vector<std::vector<Document>> output(queries.size());
-    transform(std::execution::par_unseq, queries.cbegin(), queries.cend(), output.begin(), [&search_server](const
-        std::string& query) {
-            return search_server.FindTopDocuments(query);
-        });
-    return std::move(output);
-}
-
-std::list<Document> ProcessQueriesJoined(
+    const std::vector<std::string>& queries);
+
+// Runs on GetDefaultThreadPool()
+std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries)
-{
-    std::list<Document> output;
-
-    for (const auto& documents : ProcessQueries(search_server, queries)) {
-        std::list<Document> tmp(documents.size());
-        transform(std::execution::par_unseq, documents.begin(), documents.end(), tmp.begin(), [](const auto& doc) {
-            return doc;
+    const std::vector<std::string>& queries);
+
+// Results of a batch in a single array: documents of query i are [offsets[i], offsets[i + 1]).
+// Iterating visits every document in query order, GetQueries() visits the per-query spans
+class JoinedQueryResults {
+public:
+    using const_iterator = std::vector<Document>::const_iterator;
+
+    JoinedQueryResults(std::vector<Document> documents, std::vector<size_t> offsets);
+
+    size_t GetQueryCount() const noexcept {
+        return offsets_.size() - 1;
+    }
+
+    std::span<const Document> GetQueryResults(size_t query_index) const {
+        return GetDocuments().subspan(offsets_[query_index], offsets_[query_index + 1] - offsets_[query_index]);
+    }
+
+    auto GetQueries() const {
+        return std::views::iota(size_t{ 0 }, GetQueryCount())
+            | std::views::transform([this](size_t query_index) {
+                return GetQueryResults(query_index);
             });
-        output.splice(output.end(), std::move(tmp));
     }
 
-    return output;
-}
\ No newline at end of file
+    std::span<const Document> GetDocuments() const noexcept {
+        return documents_;
+    }
+
+    size_t size() const noexcept {
+        return documents_.size();
+    }
+
+    const_iterator begin() const noexcept {
+        return documents_.begin();
+    }
+
+    const_iterator end() const noexcept {
+        return documents_.end();
+    }
+
+private:
+    std::vector<Document> documents_;
+    std::vector<size_t> offsets_;
+};
+
+// Every query writes its results straight into its own slots of the joined array,
+// which is compacted in place once the batch is done
+JoinedQueryResults ProcessQueriesJoined(
+    ThreadPool& pool,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Runs on GetDefaultThreadPool()
+JoinedQueryResults ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
@@ -0,0 +1,86 @@
+#include "query_result_cache.h"
+
+#include <algorithm>
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+    : shards_(max<size_t>(1, min(shard_count, capacity))) {
+    shard_capacity_ = (capacity + shards_.size() - 1) / shards_.size();
+}
+
+optional<vector<Document>> QueryResultCache::Find(const Key& key, uint64_t epoch) {
+    Shard& shard = GetShard(key);
+    lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        ++shard.misses;
+        return nullopt;
+    }
+    if (it->second->epoch != epoch) {
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+        ++shard.misses;
+        return nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    ++shard.hits;
+    return it->second->documents;
+}
+
+void QueryResultCache::Store(const Key& key, uint64_t epoch, const vector<Document>& documents) {
+    if (shard_capacity_ == 0) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    lock_guard guard(shard.mutex);
+    // Another reader may have stored the same query in the meantime
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+        it->second->epoch = epoch;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    if (shard.entries.size() == shard_capacity_) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+        ++shard.evictions;
+    }
+    shard.entries.push_front({ key, epoch, documents });
+    shard.index.emplace(key, shard.entries.begin());
+}
+
+QueryResultCache::Statistics QueryResultCache::GetStatistics() const {
+    Statistics statistics;
+    for (const Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        statistics.hits += shard.hits;
+        statistics.misses += shard.misses;
+        statistics.evictions += shard.evictions;
+        statistics.size += shard.entries.size();
+    }
+    return statistics;
+}
+
+size_t QueryResultCache::KeyHash::operator()(const Key& key) const noexcept {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x100000001b3ULL;
+    };
+    for (const int word : key.plus_words) {
+        mix(static_cast<uint32_t>(word));
+    }
+    // Separates plus words from minus words
+    mix(~0ULL);
+    for (const int word : key.minus_words) {
+        mix(static_cast<uint32_t>(word));
+    }
+    mix(static_cast<uint64_t>(key.status));
+    mix(key.result_count);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const Key& key) {
+    // The low bits go to the buckets of the shard's own map
+    return shards_[(KeyHash{}(key) >> 16) % shards_.size()];
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// LRU cache of search results split into independently locked shards.
+// Every entry remembers the index epoch it was computed at, and a lookup
+// with another epoch drops it, so bumping the epoch invalidates everything.
+class QueryResultCache {
+public:
+    // A parsed query: sorted and deduplicated term ids, plus what was asked for
+    struct Key {
+        std::vector<int> plus_words;
+        std::vector<int> minus_words;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        size_t result_count = 0;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+    };
+
+    QueryResultCache(size_t capacity, size_t shard_count);
+
+    std::optional<std::vector<Document>> Find(const Key& key, uint64_t epoch);
+
+    void Store(const Key& key, uint64_t epoch, const std::vector<Document>& documents);
+
+    Statistics GetStatistics() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const noexcept;
+    };
+
+    struct Entry {
+        Key key;
+        uint64_t epoch;
+        std::vector<Document> documents;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        // Most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+
+    Shard& GetShard(const Key& key);
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense relevance accumulator for a contiguous range of document ordinals.
+// Only touched slots are visited and reset, so an accumulator reused between
+// queries costs nothing for documents the query doesn't reach.
+class RelevanceAccumulator {
+public:
+    void Reserve(size_t size) {
+        if (relevances_.size() < size) {
+            relevances_.resize(size);
+            states_.resize(size, EMPTY);
+        }
+    }
+
+    void Exclude(size_t offset) {
+        if (states_[offset] == EMPTY) {
+            touched_.push_back(static_cast<uint32_t>(offset));
+        }
+        states_[offset] = EXCLUDED;
+    }
+
+    bool IsExcluded(size_t offset) const {
+        return states_[offset] == EXCLUDED;
+    }
+
+    bool IsScored(size_t offset) const {
+        return states_[offset] == SCORED;
+    }
+
+    void Add(size_t offset, double relevance) {
+        if (states_[offset] == EMPTY) {
+            touched_.push_back(static_cast<uint32_t>(offset));
+            states_[offset] = SCORED;
+            relevances_[offset] = relevance;
+        }
+        else {
+            relevances_[offset] += relevance;
+        }
+    }
+
+    template <typename Function>
+    void ForEachScored(Function function) const {
+        for (const uint32_t offset : touched_) {
+            if (states_[offset] == SCORED) {
+                function(offset, relevances_[offset]);
+            }
+        }
+    }
+
+    void Clear() {
+        for (const uint32_t offset : touched_) {
+            states_[offset] = EMPTY;
+        }
+        touched_.clear();
+    }
+
+private:
+    enum State : uint8_t {
+        EMPTY,
+        SCORED,
+        EXCLUDED,
+    };
+
+    std::vector<double> relevances_;
+    std::vector<State> states_;
+    std::vector<uint32_t> touched_;
+};
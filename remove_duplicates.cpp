@@ -1,5 +1,11 @@
 #include "remove_duplicates.h"
 
+#include <algorithm>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <unordered_set>
+
 using namespace std;
 
 bool IsDuplicate(const map<string_view, double>& first, const map<string_view, double>& second) {
@@ -10,19 +16,100 @@ bool IsDuplicate(const map<string_view, double>& first, const map<string_view, d
 	return true;
 }
 
+vector<int> FindDuplicates(const SearchServer& search_server) {
+	// Ids come in ascending order, so the first document seen with a fingerprint keeps it
+	unordered_set<TermSetFingerprint, TermSetFingerprintHash> fingerprints;
+	fingerprints.reserve(search_server.GetDocumentCount());
+	vector<int> duplicate_ids;
+	for (const int document_id : search_server) {
+		if (!fingerprints.insert(search_server.GetTermSetFingerprint(document_id)).second) {
+			duplicate_ids.push_back(document_id);
+		}
+	}
+	return duplicate_ids;
+}
+
 void RemoveDuplicates(SearchServer& search_server) {
-	set<int> ids_to_remove;
-	for (auto it = search_server.begin(); it != search_server.end();) {
-		if (!ids_to_remove.count(*it)) {
-			for (auto jt = ++it; jt != search_server.end(); ++jt) {
-				if (IsDuplicate(search_server.GetWordFrequencies(*it), search_server.GetWordFrequencies(*jt))) {
-					cout << "Found duplicate document id "s << *jt << endl;
-					ids_to_remove.insert(*jt);
-				}
+	const vector<int> duplicate_ids = FindDuplicates(search_server);
+	for (const int document_id : duplicate_ids) {
+		cout << "Found duplicate document id "s << document_id << '\n';
+	}
+	search_server.RemoveDocuments(duplicate_ids);
+}
+
+vector<NearDuplicateCluster> FindNearDuplicates(const SearchServer& search_server, double threshold) {
+	if (!(threshold > 0.0 && threshold <= 1.0)) {
+		throw invalid_argument("threshold must be in (0, 1]"s);
+	}
+	const vector<int> document_ids(search_server.begin(), search_server.end());
+	vector<span<const uint32_t>> signatures(document_ids.size());
+	transform(document_ids.begin(), document_ids.end(), signatures.begin(), [&search_server](int document_id) {
+		return search_server.GetMinHashSignature(document_id);
+	});
+
+	// For every band, the lowest position sharing each document's bucket (the document itself
+	// when nothing else falls into it)
+	vector<size_t> bands(MIN_HASH_BAND_COUNT);
+	iota(bands.begin(), bands.end(), 0);
+	vector<vector<size_t>> bucket_heads(MIN_HASH_BAND_COUNT);
+	for_each(execution::par, bands.begin(), bands.end(), [&](size_t band) {
+		// Sorting (band hash, position) pairs groups every bucket into a run, lowest position first
+		vector<pair<uint64_t, size_t>> keys(signatures.size());
+		for (size_t i = 0; i < signatures.size(); ++i) {
+			keys[i] = { HashMinHashBand(signatures[i], band), i };
+		}
+		sort(keys.begin(), keys.end());
+		vector<size_t>& heads = bucket_heads[band];
+		heads.resize(signatures.size());
+		for (size_t first = 0, last = 0; first < keys.size(); first = last) {
+			while (last < keys.size() && keys[last].first == keys[first].first) {
+				heads[keys[last++].second] = keys[first].second;
+			}
+		}
+	});
+
+	// Positions in ascending order either join the cluster of a lower position or start their
+	// own. A document is compared only with the representative of each bucket head, so every
+	// member reaches threshold against its representative and a bucket of identical signatures
+	// costs one comparison per member
+	vector<size_t> representatives(document_ids.size());
+	for (size_t i = 0; i < document_ids.size(); ++i) {
+		representatives[i] = i;
+		for (const vector<size_t>& heads : bucket_heads) {
+			const size_t candidate = representatives[heads[i]];
+			if (candidate < representatives[i] && EstimateJaccard(signatures[candidate], signatures[i]) >= threshold) {
+				representatives[i] = candidate;
 			}
 		}
 	}
-	for (int id : ids_to_remove) {
-		search_server.RemoveDocument(id);
+
+	vector<NearDuplicateCluster> clusters;
+	vector<size_t> cluster_indexes(document_ids.size(), SIZE_MAX);
+	for (size_t i = 0; i < document_ids.size(); ++i) {
+		const size_t representative = representatives[i];
+		if (representative == i) {
+			continue;
+		}
+		if (cluster_indexes[representative] == SIZE_MAX) {
+			cluster_indexes[representative] = clusters.size();
+			clusters.push_back({ document_ids[representative], {} });
+		}
+		clusters[cluster_indexes[representative]].duplicates.emplace_back(document_ids[i], EstimateJaccard(signatures[representative], signatures[i]));
 	}
-}
\ No newline at end of file
+	sort(clusters.begin(), clusters.end(), [](const NearDuplicateCluster& lhs, const NearDuplicateCluster& rhs) {
+		return lhs.document_id < rhs.document_id;
+	});
+	return clusters;
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, double threshold) {
+	vector<int> duplicate_ids;
+	for (const NearDuplicateCluster& cluster : FindNearDuplicates(search_server, threshold)) {
+		for (const auto& [document_id, similarity] : cluster.duplicates) {
+			cout << "Found near duplicate document id "s << document_id << " of "s << cluster.document_id
+				<< ", similarity "s << similarity << '\n';
+			duplicate_ids.push_back(document_id);
+		}
+	}
+	search_server.RemoveDocuments(duplicate_ids);
+}
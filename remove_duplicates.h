@@ -1,6 +1,28 @@
 #pragma once
 #include "search_server.h"
 
-bool IsDuplicate(std::map<std::string_view, double>& first, std::map<std::string_view, double>& second);
+bool IsDuplicate(const std::map<std::string_view, double>& first, const std::map<std::string_view, double>& second);
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+// Ids of documents whose set of words repeats that of a document with a lower id, ascending.
+// One pass over the documents comparing term set fingerprints
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+// Keeps the lowest id of every group of documents with the same words
+void RemoveDuplicates(SearchServer& search_server);
+
+// Documents with nearly the same words as document_id, the lowest id of the cluster
+struct NearDuplicateCluster {
+    int document_id = 0;
+    // (id, Jaccard similarity to document_id estimated from MinHash signatures), ids ascending
+    std::vector<std::pair<int, double>> duplicates;
+};
+
+// Clusters of documents whose estimated Jaccard similarity of word sets reaches threshold,
+// ordered by document_id. Candidates come from LSH buckets over MinHash signature bands; a
+// document joins a cluster only if its estimated similarity to the cluster's document_id
+// reaches threshold, so no member is removed for resembling another member alone.
+// Needs near-duplicate detection to be on
+std::vector<NearDuplicateCluster> FindNearDuplicates(const SearchServer& search_server, double threshold);
+
+// Keeps the lowest id of every cluster found by FindNearDuplicates
+void RemoveNearDuplicates(SearchServer& search_server, double threshold);
@@ -9,9 +9,9 @@ RequestQueue::RequestQueue(const SearchServer& search_server) {
 
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-        });
+    return RecordRequest([&] {
+        return search_server_->FindTopDocuments(raw_query, status);
+    });
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
@@ -19,5 +19,5 @@ vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return no_results_requests_count_;
+    return static_cast<int>(statistics_.GetSummary(chrono::minutes(min_in_day_)).no_result_count);
 }
\ No newline at end of file
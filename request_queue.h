@@ -1,40 +1,41 @@
 #pragma once
 
 #include "search_server.h"
-#include <deque>
+#include "request_statistics.h"
 
+// Runs searches and keeps statistics of them over the last day. May be used from several threads at once
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer& search_server);
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        QueryResult result;
-        result.raw_query = raw_query;
-        result.documents = search_server_->FindTopDocuments(raw_query, document_predicate);
-        if (result.documents.empty())
-            ++no_results_requests_count_;
-
-        requests_.push_back(result);
-
-        if (requests_.size() > min_in_day_) {
-            if (requests_.front().documents.empty())
-                --no_results_requests_count_;
-            requests_.pop_front();
-        }
-        return result.documents;
+        return RecordRequest([&] {
+            return search_server_->FindTopDocuments(raw_query, document_predicate);
+        });
     }
 
+    // Goes through the result cache of the server, unlike the predicate overload
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
 
     std::vector<Document> AddFindRequest(const std::string& raw_query);
+    // Requests of the last day that found nothing
     int GetNoResultRequests() const;
+
+    const RequestStatistics& GetStatistics() const noexcept {
+        return statistics_;
+    }
+
 private:
-    struct QueryResult {
-        std::string raw_query;
-        std::vector<Document> documents;
-    };
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
+    static constexpr int min_in_day_ = 1440;
     const SearchServer* search_server_;
-    int no_results_requests_count_ = 0;
+    RequestStatistics statistics_{ min_in_day_ };
+
+    template <typename Search>
+    std::vector<Document> RecordRequest(Search search) {
+        const auto start = RequestStatistics::Clock::now();
+        std::vector<Document> documents = search();
+        const auto finish = RequestStatistics::Clock::now();
+        statistics_.Record(documents.size(), finish - start, finish);
+        return documents;
+    }
 };
@@ -0,0 +1,155 @@
+#include "request_statistics.h"
+
+#include <algorithm>
+#include <bit>
+#include <thread>
+
+using namespace std;
+
+size_t LatencyHistogram::GetBucket(chrono::nanoseconds latency) noexcept {
+    const uint64_t max_value = (uint64_t{ 1 } << MAX_VALUE_BITS) - 1;
+    const uint64_t value = min(static_cast<uint64_t>(max<int64_t>(chrono::duration_cast<chrono::microseconds>(latency).count(), 0)), max_value);
+    if (value < SUB_BUCKET_COUNT) {
+        return value;
+    }
+    // value >> shift keeps the top SUB_BUCKET_BITS bits, the highest of which is always set
+    const int shift = bit_width(value) - SUB_BUCKET_BITS;
+    return SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_COUNT / 2 + ((value >> shift) - SUB_BUCKET_COUNT / 2);
+}
+
+chrono::microseconds LatencyHistogram::GetBucketMaxValue(size_t bucket) noexcept {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return chrono::microseconds(bucket);
+    }
+    const size_t shift = (bucket - SUB_BUCKET_COUNT) / (SUB_BUCKET_COUNT / 2) + 1;
+    const uint64_t top_bits = (bucket - SUB_BUCKET_COUNT) % (SUB_BUCKET_COUNT / 2) + SUB_BUCKET_COUNT / 2;
+    return chrono::microseconds(((top_bits + 1) << shift) - 1);
+}
+
+chrono::microseconds LatencyHistogram::GetPercentile(double fraction) const noexcept {
+    if (total_count_ == 0) {
+        return {};
+    }
+    const auto rank = max<uint64_t>(1, static_cast<uint64_t>(clamp(fraction, 0.0, 1.0) * total_count_ + 0.5));
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        count += counts_[bucket];
+        if (count >= rank) {
+            return GetBucketMaxValue(bucket);
+        }
+    }
+    return GetMax();
+}
+
+chrono::microseconds LatencyHistogram::GetMax() const noexcept {
+    for (size_t bucket = BUCKET_COUNT; bucket > 0; --bucket) {
+        if (counts_[bucket - 1] != 0) {
+            return GetBucketMaxValue(bucket - 1);
+        }
+    }
+    return {};
+}
+
+RequestStatistics::RequestStatistics(size_t minute_count)
+    : minute_count_(max<size_t>(minute_count, 1))
+    , buckets_(make_unique<MinuteBucket[]>(minute_count_)) {
+}
+
+void RequestStatistics::Record(size_t result_count, chrono::nanoseconds latency, Clock::time_point time) noexcept {
+    const int64_t minute = ToMinute(time);
+    MinuteBucket& bucket = buckets_[minute % minute_count_];
+    // Entering the bucket and then seeing the minute still held keeps a later minute from
+    // clearing it until both increments are done: the clearer takes the minute first and
+    // then waits for the recorders inside, and seq_cst orders the two sides like Dekker's
+    while (true) {
+        if (!ClaimBucket(bucket, minute)) {
+            return;
+        }
+        bucket.recorder_count.fetch_add(1, memory_order_seq_cst);
+        if (bucket.minute.load(memory_order_seq_cst) == minute) {
+            break;
+        }
+        bucket.recorder_count.fetch_sub(1, memory_order_release);
+    }
+    bucket.result_counts[min(result_count, RESULT_COUNT_LIMIT)].fetch_add(1, memory_order_relaxed);
+    bucket.latencies[LatencyHistogram::GetBucket(latency)].fetch_add(1, memory_order_relaxed);
+    bucket.recorder_count.fetch_sub(1, memory_order_release);
+}
+
+RequestStatistics::Summary RequestStatistics::GetSummary(Clock::time_point first, Clock::time_point last) const {
+    Summary summary;
+    const int64_t last_minute = ToMinute(last);
+    const int64_t first_minute = max(ToMinute(first), last_minute - static_cast<int64_t>(minute_count_) + 1);
+    for (int64_t minute = first_minute; minute <= last_minute; ++minute) {
+        AddBucket(buckets_[minute % minute_count_], minute, summary);
+    }
+    return summary;
+}
+
+RequestStatistics::Summary RequestStatistics::GetSummary(chrono::minutes window, Clock::time_point now) const {
+    if (window <= chrono::minutes(0)) {
+        return {};
+    }
+    return GetSummary(now - (window - chrono::minutes(1)), now);
+}
+
+int64_t RequestStatistics::ToMinute(Clock::time_point time) noexcept {
+    return chrono::duration_cast<chrono::minutes>(time.time_since_epoch()).count();
+}
+
+bool RequestStatistics::ClaimBucket(MinuteBucket& bucket, int64_t minute) noexcept {
+    int64_t current = bucket.minute.load(memory_order_acquire);
+    while (current != minute) {
+        if (current == CLEARING) {
+            this_thread::yield();
+            current = bucket.minute.load(memory_order_acquire);
+        }
+        else if (current > minute) {
+            return false;
+        }
+        else if (bucket.minute.compare_exchange_weak(current, CLEARING, memory_order_seq_cst)) {
+            // Recorders of the old minute finish their increments first
+            while (bucket.recorder_count.load(memory_order_seq_cst) != 0) {
+                this_thread::yield();
+            }
+            // Readers that see a cleared counter see CLEARING too, like with a seqlock
+            atomic_thread_fence(memory_order_release);
+            for (auto& count : bucket.result_counts) {
+                count.store(0, memory_order_relaxed);
+            }
+            for (auto& count : bucket.latencies) {
+                count.store(0, memory_order_relaxed);
+            }
+            bucket.minute.store(minute, memory_order_release);
+            return true;
+        }
+    }
+    return true;
+}
+
+void RequestStatistics::AddBucket(const MinuteBucket& bucket, int64_t minute, Summary& summary) const {
+    if (bucket.minute.load(memory_order_acquire) != minute) {
+        return;
+    }
+    array<uint32_t, RESULT_COUNT_LIMIT + 1> result_counts;
+    array<uint32_t, LatencyHistogram::BUCKET_COUNT> latencies;
+    for (size_t i = 0; i < result_counts.size(); ++i) {
+        result_counts[i] = bucket.result_counts[i].load(memory_order_relaxed);
+    }
+    for (size_t i = 0; i < latencies.size(); ++i) {
+        latencies[i] = bucket.latencies[i].load(memory_order_relaxed);
+    }
+    // A bucket recycled meanwhile holds a later minute, which the window doesn't cover
+    atomic_thread_fence(memory_order_acquire);
+    if (bucket.minute.load(memory_order_relaxed) != minute) {
+        return;
+    }
+    for (size_t i = 0; i < result_counts.size(); ++i) {
+        summary.result_counts[i] += result_counts[i];
+        summary.request_count += result_counts[i];
+    }
+    summary.no_result_count += result_counts[0];
+    for (size_t i = 0; i < latencies.size(); ++i) {
+        summary.latencies.Add(i, latencies[i]);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Latency counts in log-linear buckets, like HdrHistogram: latencies below SUB_BUCKET_COUNT
+// microseconds get a bucket each, and every larger power of two is split into
+// SUB_BUCKET_COUNT / 2 buckets, so a bucket spans at most 1/16 of its values
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+    // Latencies from 2^MAX_VALUE_BITS microseconds, over an hour, share the last bucket
+    static constexpr int MAX_VALUE_BITS = 32;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT / 2;
+
+    static size_t GetBucket(std::chrono::nanoseconds latency) noexcept;
+    // Largest latency that falls into the bucket
+    static std::chrono::microseconds GetBucketMaxValue(size_t bucket) noexcept;
+
+    void Add(size_t bucket, uint64_t count) noexcept {
+        counts_[bucket] += count;
+        total_count_ += count;
+    }
+
+    uint64_t GetCount() const noexcept {
+        return total_count_;
+    }
+
+    // Largest value of the bucket holding the given share of the latencies, zero while empty
+    std::chrono::microseconds GetPercentile(double fraction) const noexcept;
+    std::chrono::microseconds GetMax() const noexcept;
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> counts_{};
+    uint64_t total_count_ = 0;
+};
+
+// Request counts, result counts and latencies per minute in a fixed ring of minute_count
+// buckets, all allocated up front. Any number of threads may record and query at once:
+// recording is a couple of relaxed atomic increments between entering and leaving the
+// bucket, except for the first request of a minute, which waits for the recorders still in
+// the bucket of the minute that many minutes ago and clears it while concurrent recorders
+// of the new minute wait for it
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Result counts from RESULT_COUNT_LIMIT on share the last entry of Summary::result_counts
+    static constexpr size_t RESULT_COUNT_LIMIT = 16;
+
+    struct Summary {
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;
+        // Requests per number of results
+        std::array<uint64_t, RESULT_COUNT_LIMIT + 1> result_counts{};
+        LatencyHistogram latencies;
+    };
+
+    explicit RequestStatistics(size_t minute_count);
+
+    // Requests older than minute_count minutes before the latest one recorded are dropped
+    void Record(size_t result_count, std::chrono::nanoseconds latency, Clock::time_point time = Clock::now()) noexcept;
+
+    // Requests of the minutes from the one holding first to the one holding last, within the ring
+    Summary GetSummary(Clock::time_point first, Clock::time_point last) const;
+    // Requests of the last window minutes, the current one included
+    Summary GetSummary(std::chrono::minutes window, Clock::time_point now = Clock::now()) const;
+
+    size_t GetMinuteCount() const noexcept {
+        return minute_count_;
+    }
+
+private:
+    static constexpr int64_t NO_MINUTE = -1;
+    static constexpr int64_t CLEARING = -2;
+
+    struct alignas(64) MinuteBucket {
+        // Minute the counters belong to; CLEARING while they are reset for another one
+        std::atomic<int64_t> minute = NO_MINUTE;
+        // Recorders between claiming the minute and their last increment
+        std::atomic<uint32_t> recorder_count = 0;
+        // Requests and no-result requests are sums of these
+        std::array<std::atomic<uint32_t>, RESULT_COUNT_LIMIT + 1> result_counts{};
+        std::array<std::atomic<uint32_t>, LatencyHistogram::BUCKET_COUNT> latencies{};
+    };
+
+    size_t minute_count_;
+    std::unique_ptr<MinuteBucket[]> buckets_;
+
+    static int64_t ToMinute(Clock::time_point time) noexcept;
+
+    // Makes the bucket hold minute, clearing it if it holds an earlier one.
+    // False if it has moved on to a later minute already
+    bool ClaimBucket(MinuteBucket& bucket, int64_t minute) noexcept;
+    // Adds the counters of the bucket if it holds minute
+    void AddBucket(const MinuteBucket& bucket, int64_t minute, Summary& summary) const;
+};
@@ -1,34 +1,235 @@
 #include "search_server.h"
+#include "memory_usage.h"
+#include "snapshot.h"
+#include "tokenizer.h"
+
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if (document_id < 0) {
-        throw invalid_argument("   id"s);
+    INSTRUMENT_CALL(ADD_DOCUMENT);
+    CheckWritable();
+    // Splitting checks the text for control characters in the same pass
+    static thread_local vector<string_view> words;
+    const bool has_valid_text = TokenizeWords(document, words);
+    ValidateNewDocument(document_id, documents_.Contains(document_id), has_valid_text);
+    RemoveStopWords(words);
+    if (reject_duplicates_) {
+        ValidateNewDocumentWords(HasLiveDuplicate(words));
     }
-    if (documents_.count(document_id)) {
-        throw invalid_argument(" c id   "s);
+    const int ordinal = documents_.Add(document_id, ComputeAverageRating(ratings), status);
+    epoch_ = NextEpoch();
+
+    const double inv_word_count = 1.0 / words.size();
+    map<int, double> word_freqs;
+    for (const string_view word : words) {
+        word_freqs[terms_.AddTerm(word)] += inv_word_count;
     }
-    if (!IsValidWord(document)) {
-        throw invalid_argument("  "s);
+    TermSetFingerprint fingerprint;
+    vector<int> word_ids;
+    word_ids.reserve(word_freqs.size());
+    for (const auto& [word, term_freq] : word_freqs) {
+        fingerprint.Add(word);
+        word_ids.push_back(word);
+    }
+    AddFingerprint(fingerprint);
+    if (near_duplicate_detection_) {
+        array<uint32_t, MIN_HASH_SIZE> signature;
+        ComputeMinHash(word_ids, signature);
+        min_hashes_.push_back(signature);
+    }
+    AddEmptyPostings();
+    word_statistics_.resize(terms_.GetTermCount());
+    INSTRUMENT_COUNT(POSTINGS_ADDED, word_freqs.size());
+    for (const auto& [word, term_freq] : word_freqs) {
+        PostingList& postings = GetMutablePostings(word);
+        postings.Add(ordinal, term_freq);
+        postings.Flush();
+        UpdateWordStatistics(word, term_freq);
+    }
+    document_to_word_freqs_.Add(word_freqs);
+}
+
+// Index of a slice of a batch, built without touching the server. Terms have
+// slice-local ids and documents are referred to by their offset in the batch
+struct SearchServer::PartialIndex {
+    unordered_map<string_view, int> term_ids;
+    vector<string_view> terms;
+    // (batch offset, term frequency) per local term, offsets ascending
+    vector<vector<pair<int, double>>> postings;
+    // (local term, position in its postings) per document of the slice
+    vector<vector<pair<int, int>>> document_words;
+};
+
+void SearchServer::AddDocuments(span<const DocumentInput> documents) {
+    INSTRUMENT_CALL(ADD_DOCUMENT);
+    CheckWritable();
+    const size_t max_slice_count = max(1u, thread::hardware_concurrency()) * 4;
+    const size_t slice_count = clamp<size_t>(documents.size() / MIN_BATCH_SLICE_SIZE, 1, max_slice_count);
+    vector<PartialIndex> partial_indexes(slice_count);
+    vector<size_t> slices(slice_count);
+    iota(slices.begin(), slices.end(), 0);
+    const auto slice_begin = [&documents, slice_count](size_t slice) {
+        return documents.size() * slice / slice_count;
+    };
+    // Partial indexes don't touch the server, so texts are checked while they are tokenized
+    vector<char> has_valid_text(documents.size());
+    for_each(execution::par, slices.begin(), slices.end(), [&](size_t slice) {
+        BuildPartialIndex(documents, slice_begin(slice), slice_begin(slice + 1), partial_indexes[slice], has_valid_text);
+    });
+    unordered_set<int> batch_ids;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const int document_id = documents[i].document_id;
+        const bool is_duplicate = documents_.Contains(document_id) || !batch_ids.insert(document_id).second;
+        ValidateNewDocument(document_id, is_duplicate, has_valid_text[i]);
     }
 
-    const vector<string> words = Stringify(SplitIntoWordsNoStop(document));
-    for (auto& word : words) {
-        word_to_document_freqs_[word][document_id] += 1.0 / words.size();
+    // Slice-local term ids are mapped to global ones; each touched term lists its (slice, local id) sources.
+    // Terms missing from the dictionary get the ids AddTerm will give them, and are added only once
+    // the batch is known to be accepted
+    vector<vector<int>> global_term_ids(slice_count);
+    vector<int> touched_words;
+    vector<vector<pair<size_t, int>>> word_sources;
+    vector<string_view> new_terms;
+    unordered_map<string_view, int> new_term_ids;
+    for (size_t slice = 0; slice < slice_count; ++slice) {
+        const PartialIndex& index = partial_indexes[slice];
+        global_term_ids[slice].reserve(index.terms.size());
+        for (size_t local = 0; local < index.terms.size(); ++local) {
+            const string_view term = index.terms[local];
+            int word = terms_.FindTerm(term);
+            if (word == TermDictionary::NO_TERM) {
+                const auto [it, inserted] = new_term_ids.emplace(term, terms_.GetTermCount() + static_cast<int>(new_terms.size()));
+                if (inserted) {
+                    new_terms.push_back(term);
+                }
+                word = it->second;
+            }
+            global_term_ids[slice].push_back(word);
+            if (static_cast<size_t>(word) >= word_sources.size()) {
+                word_sources.resize(word + 1);
+            }
+            if (word_sources[word].empty()) {
+                touched_words.push_back(word);
+            }
+            word_sources[word].emplace_back(slice, static_cast<int>(local));
+        }
+    }
+
+    vector<TermSetFingerprint> fingerprints(documents.size());
+    vector<array<uint32_t, MIN_HASH_SIZE>> min_hashes(near_duplicate_detection_ ? documents.size() : 0);
+    for_each(execution::par, slices.begin(), slices.end(), [&](size_t slice) {
+        const PartialIndex& index = partial_indexes[slice];
+        vector<int> words;
+        for (size_t i = 0; i < index.document_words.size(); ++i) {
+            words.clear();
+            for (const auto& [local, position] : index.document_words[i]) {
+                words.push_back(global_term_ids[slice][local]);
+            }
+            sort(words.begin(), words.end());
+            const size_t offset = slice_begin(slice) + i;
+            for (const int word : words) {
+                fingerprints[offset].Add(word);
+            }
+            if (near_duplicate_detection_) {
+                ComputeMinHash(words, min_hashes[offset]);
+            }
+        }
+    });
+    if (reject_duplicates_) {
+        unordered_set<TermSetFingerprint, TermSetFingerprintHash> batch_fingerprints;
+        for (const TermSetFingerprint& fingerprint : fingerprints) {
+            ValidateNewDocumentWords(live_fingerprint_counts_.count(fingerprint) > 0 || !batch_fingerprints.insert(fingerprint).second);
+        }
+    }
+
+    // New terms have empty postings until the batch is indexed, like terms of removed documents
+    for (const string_view term : new_terms) {
+        terms_.AddTerm(term);
+    }
+    AddEmptyPostings();
+    word_statistics_.resize(terms_.GetTermCount());
+
+    // Ordinals of the batch follow the existing ones, so appended postings stay sorted
+    const int first_ordinal = documents_.GetOrdinalCount();
+    epoch_ = NextEpoch();
+    for (size_t i = 0; i < documents.size(); ++i) {
+        documents_.Add(documents[i].document_id, ComputeAverageRating(documents[i].ratings), documents[i].status);
+        AddFingerprint(fingerprints[i]);
     }
-    for (auto& word : words) {
-        document_to_word_freqs_[document_id][word] += 1.0 / words.size();
+    for (const auto& signature : min_hashes) {
+        min_hashes_.push_back(signature);
+    }
+    // Postings shared with a copy are cloned before the parallel part
+    vector<PostingList*> touched_postings(terms_.GetTermCount());
+    for (const int word : touched_words) {
+        touched_postings[word] = &GetMutablePostings(word);
+    }
+
+    // Every word is owned by one task, and every document by one slice
+    for_each(execution::par, touched_words.begin(), touched_words.end(), [&](int word) {
+        PostingList& postings = *touched_postings[word];
+        double term_freq_sum = 0.0;
+        for (const auto& [slice, local] : word_sources[word]) {
+            for (const auto& [offset, term_freq] : partial_indexes[slice].postings[local]) {
+                postings.Add(first_ordinal + offset, term_freq);
+                term_freq_sum += term_freq;
+            }
+        }
+        postings.Flush();
+        UpdateWordStatistics(word, term_freq_sum);
+    });
+    vector<vector<pair<int, double>>> document_word_freqs(documents.size());
+    for_each(execution::par, slices.begin(), slices.end(), [&](size_t slice) {
+        const PartialIndex& index = partial_indexes[slice];
+        for (size_t i = 0; i < index.document_words.size(); ++i) {
+            auto& word_freqs = document_word_freqs[slice_begin(slice) + i];
+            word_freqs.reserve(index.document_words[i].size());
+            for (const auto& [local, position] : index.document_words[i]) {
+                word_freqs.emplace_back(global_term_ids[slice][local], index.postings[local][position].second);
+            }
+            sort(word_freqs.begin(), word_freqs.end());
+        }
+    });
+    for (const auto& word_freqs : document_word_freqs) {
+        INSTRUMENT_COUNT(POSTINGS_ADDED, word_freqs.size());
+        document_to_word_freqs_.Add(word_freqs);
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
-    document_ids_.emplace(document_id);
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query,
-        [&status](int document_id, DocumentStatus new_status, int rating) {
-            return new_status == status;
-        });
+void SearchServer::BuildPartialIndex(span<const DocumentInput> documents, size_t first, size_t last, PartialIndex& index,
+    vector<char>& has_valid_text) const {
+    index.document_words.resize(last - first);
+    vector<string_view> words;
+    for (size_t offset = first; offset < last; ++offset) {
+        has_valid_text[offset] = TokenizeWords(documents[offset].text, words);
+        if (!has_valid_text[offset]) {
+            continue;
+        }
+        RemoveStopWords(words);
+        const double inv_word_count = 1.0 / words.size();
+        auto& document_words = index.document_words[offset - first];
+        for (const string_view word : words) {
+            const auto [it, inserted] = index.term_ids.emplace(word, static_cast<int>(index.terms.size()));
+            if (inserted) {
+                index.terms.push_back(word);
+                index.postings.emplace_back();
+            }
+            auto& postings = index.postings[it->second];
+            if (postings.empty() || postings.back().first != static_cast<int>(offset)) {
+                document_words.emplace_back(it->second, static_cast<int>(postings.size()));
+                postings.emplace_back(static_cast<int>(offset), 0.0);
+            }
+            postings.back().second += inv_word_count;
+        }
+    }
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t result_count) const {
+    return FindTopDocumentsByStatus(execution::seq, raw_query, status, result_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
@@ -36,63 +237,135 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
 }
 
 
-vector<Document> SearchServer::FindTopDocuments(const execution::parallel_policy&, string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(execution::par, raw_query,
-        [&status](int document_id, DocumentStatus new_status, int rating) {
-            return new_status == status;
-        });
+vector<Document> SearchServer::FindTopDocuments(const execution::parallel_policy&, string_view raw_query, DocumentStatus status, size_t result_count) const {
+    return FindTopDocumentsByStatus(execution::par, raw_query, status, result_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(const execution::parallel_policy&, string_view raw_query) const {
     return FindTopDocuments(execution::par, raw_query, DocumentStatus::ACTUAL);
 }
 
-vector<Document> SearchServer::FindTopDocuments(const execution::sequenced_policy&, string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(execution::seq, raw_query,
-        [&status](int document_id, DocumentStatus new_status, int rating) {
-            return new_status == status;
-        });
+vector<Document> SearchServer::FindTopDocuments(const execution::sequenced_policy&, string_view raw_query, DocumentStatus status, size_t result_count) const {
+    return FindTopDocumentsByStatus(execution::seq, raw_query, status, result_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(const execution::sequenced_policy&, string_view raw_query) const {
     return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+template <typename ExecutionPolicy>
+vector<Document> SearchServer::FindTopDocumentsByStatus(ExecutionPolicy&& policy, string_view raw_query, DocumentStatus status, size_t result_count) const {
+    INSTRUMENT_CALL(SEARCH);
+    const Query query = ParseQuery(raw_query);
+    const StatusFilter predicate{ status };
+    if (!result_cache_) {
+        return FindAllDocuments(policy, query, predicate, result_count).Extract();
+    }
+
+    const QueryResultCache::Key key{ query.plus_words, query.minus_words, status, result_count };
+    if (auto documents = result_cache_->Find(key, epoch_)) {
+        return move(*documents);
+    }
+    vector<Document> documents = FindAllDocuments(policy, query, predicate, result_count).Extract();
+    result_cache_->Store(key, epoch_, documents);
+    return documents;
+}
+
+void SearchServer::SetRetrievalMode(RetrievalMode mode) {
+    retrieval_mode_ = mode;
+}
+
+RetrievalMode SearchServer::GetRetrievalMode() const {
+    return retrieval_mode_;
+}
+
+size_t SearchServer::WriteTopDocuments(string_view raw_query, span<Document> output, DocumentStatus status) const {
+    INSTRUMENT_CALL(SEARCH);
+    if (result_cache_) {
+        const vector<Document> documents = FindTopDocumentsByStatus(execution::seq, raw_query, status, output.size());
+        return copy(documents.begin(), documents.end(), output.begin()) - output.begin();
+    }
+    return FindAllDocuments(execution::seq, ParseQuery(raw_query), StatusFilter{ status }, output.size()).ExtractTo(output);
+}
+
+DocumentPage SearchServer::FindDocumentsPage(string_view raw_query, size_t offset, size_t limit, DocumentStatus status) const {
+    INSTRUMENT_CALL(SEARCH);
+    const Query query = ParseQuery(raw_query);
+    vector<Document> documents = FindAllDocuments(execution::seq, query, StatusFilter{ status }, offset + min(limit, SIZE_MAX - offset)).Extract();
+    optional<Document> previous;
+    if (offset > 0 && documents.size() >= offset) {
+        previous = documents[offset - 1];
+    }
+    documents.erase(documents.begin(), documents.begin() + min(offset, documents.size()));
+    return MakeDocumentPage(raw_query, status, offset, move(documents), limit, previous);
+}
+
+DocumentPage SearchServer::FindDocumentsPage(const PageCursor& cursor, size_t limit) const {
+    INSTRUMENT_CALL(SEARCH);
+    if (cursor.IsEnd() || limit == 0) {
+        return { {}, cursor };
+    }
+    const Query query = ParseQuery(cursor.raw_query_);
+    // A cursor that returned nothing yet starts from the top
+    const optional<Document> after = cursor.position_ > 0 ? optional<Document>(cursor.last_) : nullopt;
+    vector<Document> documents = FindAllDocuments(execution::seq, query, StatusFilter{ cursor.status_ }, limit, after).Extract();
+    return MakeDocumentPage(cursor.raw_query_, cursor.status_, cursor.position_, move(documents), limit, after);
+}
+
+DocumentPage SearchServer::MakeDocumentPage(string_view raw_query, DocumentStatus status, size_t first_position, vector<Document> documents,
+    size_t limit, const optional<Document>& previous) const {
+    DocumentPage page;
+    PageCursor& next = page.next;
+    next.raw_query_ = raw_query;
+    next.status_ = status;
+    next.epoch_ = epoch_;
+    next.position_ = first_position + documents.size();
+    // A short page is the last one. An empty page asked for by limit 0 ends only if the
+    // ranking ran out before it
+    next.is_end_ = limit > 0 ? documents.size() < limit : first_position > 0 && !previous;
+    if (!documents.empty()) {
+        next.last_ = documents.back();
+    }
+    else if (previous) {
+        next.last_ = *previous;
+    }
+    page.documents = move(documents);
+    return page;
+}
+
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    return documents_.size();
 }
 
-const set<int>::const_iterator SearchServer::begin() const noexcept {
-    return document_ids_.begin();
+DocumentTable::Iterator SearchServer::begin() const noexcept {
+    return documents_.begin();
 }
 
-const set<int>::const_iterator SearchServer::end() const noexcept {
-    return document_ids_.end();
+DocumentTable::Iterator SearchServer::end() const noexcept {
+    return documents_.end();
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
     const Query query = ParseQuery(raw_query);
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
+        throw out_of_range("document_id out of range"s);
+    }
 
     vector<string_view> matched_words;
-    for (const string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count((string)word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at((string)word).count(document_id)) {
-            matched_words.clear();
-            return { {}, documents_.at(document_id).status };
+    for (const int word : query.minus_words) {
+        if (GetPostings(word).Contains(ordinal)) {
+            return { vector<string_view>{}, documents_.GetStatus(ordinal) };
         }
     }
-    for (const string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count((string)word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at((string)word).count(document_id)) {
-            matched_words.push_back(word);
+    for (const int word : query.plus_words) {
+        if (GetPostings(word).Contains(ordinal)) {
+            matched_words.push_back(terms_.GetTerm(word));
         }
     }
+    sort(matched_words.begin(), matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, documents_.GetStatus(ordinal) };
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy& policy, string_view raw_query, int document_id) const {
@@ -100,83 +373,464 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const exe
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy& policy, string_view raw_query, int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
         throw invalid_argument("document_id out of range"s);
     }
 
     const Query& query = ParseQueryParallel(raw_query);
-    const auto& word_freqs = document_to_word_freqs_.at(document_id);
+    const auto has_word = [this, ordinal](int word) {
+        return DocumentHasWord(ordinal, word);
+    };
 
     if (any_of(query.minus_words.begin(),
         query.minus_words.end(),
-        [&word_freqs](const string_view word) {
-            return word_freqs.count((string)word) > 0;
-        })) {
-        return { {}, documents_.at(document_id).status };
+        has_word)) {
+        return { vector<string_view>{}, documents_.GetStatus(ordinal) };
     }
 
-    vector<string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
+    vector<int> matched_ids;
+    matched_ids.reserve(query.plus_words.size());
     copy_if(query.plus_words.begin(),
         query.plus_words.end(),
-        back_inserter(matched_words),
-        [&word_freqs](const string_view word) {
-            return word_freqs.count((string)word) > 0;
+        back_inserter(matched_ids),
+        has_word);
+
+    vector<string_view> matched_words(matched_ids.size());
+    transform(policy, matched_ids.begin(), matched_ids.end(), matched_words.begin(),
+        [this](int word) {
+            return terms_.GetTerm(word);
         });
 
     sort(policy, matched_words.begin(), matched_words.end());
     auto it = unique(matched_words.begin(), matched_words.end());
     matched_words.erase(it, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, documents_.GetStatus(ordinal) };
 }
 
-const map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
-    map<string_view, double> dummy;
-    if (document_to_word_freqs_.count(document_id) == 0) {
-        return dummy;
+WordFrequencyView SearchServer::GetWordFrequencies(int document_id) const {
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
+        return {};
     }
-    else {
-        return StringViewFy(document_to_word_freqs_.at(document_id));
+    return { terms_, document_to_word_freqs_.GetEntries(ordinal) };
+}
+
+map<string_view, double> SearchServer::GetWordFrequencyMap(int document_id) const {
+    const WordFrequencyView words = GetWordFrequencies(document_id);
+    return { words.begin(), words.end() };
+}
+
+TermStatistics SearchServer::GetTermStatistics(string_view word) const {
+    const int term_id = terms_.FindTerm(word);
+    if (term_id == TermDictionary::NO_TERM || GetPostings(term_id).empty()) {
+        return {};
     }
+    return {
+        static_cast<int>(GetPostings(term_id).size()),
+        ComputeWordInverseDocumentFreq(term_id, log(GetDocumentCount())),
+        word_statistics_[term_id].total_term_freq
+    };
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (document_to_word_freqs_.count(document_id)) {
-        map<string, double> search_element = document_to_word_freqs_[document_id];
+    INSTRUMENT_CALL(REMOVE_DOCUMENT);
+    CheckWritable();
+    const int ordinal = documents_.Remove(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
+        return;
+    }
+    epoch_ = NextEpoch();
+    ForgetFingerprint(ordinal);
+    const ForwardIndex::Entries words = document_to_word_freqs_.GetEntries(ordinal);
+    INSTRUMENT_COUNT(POSTINGS_REMOVED, words.word_ids.size());
+    for (size_t i = 0; i < words.word_ids.size(); ++i) {
+        GetMutablePostings(words.word_ids[i]).Erase(ordinal);
+        UpdateWordStatistics(words.word_ids[i], -words.term_freqs[i]);
+    }
+    document_to_word_freqs_.Clear(ordinal);
+}
+
+void SearchServer::RemoveDocuments(span<const int> document_ids) {
+    INSTRUMENT_CALL(REMOVE_DOCUMENT);
+    CheckWritable();
+    vector<int> ordinals;
+    for (const int document_id : document_ids) {
+        const int ordinal = documents_.Remove(document_id);
+        if (ordinal != DocumentTable::NO_DOCUMENT) {
+            ordinals.push_back(ordinal);
+        }
+    }
+    if (ordinals.empty()) {
+        return;
+    }
+    epoch_ = NextEpoch();
+    sort(ordinals.begin(), ordinals.end());
+
+    // Ordinals removed from every touched word, ascending, and the term frequency they took along
+    vector<int> touched_words;
+    vector<vector<int>> word_ordinals(word_to_document_freqs_.size());
+    vector<double> word_term_freqs(word_to_document_freqs_.size());
+    for (const int ordinal : ordinals) {
+        ForgetFingerprint(ordinal);
+        const ForwardIndex::Entries words = document_to_word_freqs_.GetEntries(ordinal);
+        for (size_t i = 0; i < words.word_ids.size(); ++i) {
+            const int word = words.word_ids[i];
+            if (word_ordinals[word].empty()) {
+                touched_words.push_back(word);
+            }
+            word_ordinals[word].push_back(ordinal);
+            word_term_freqs[word] += words.term_freqs[i];
+        }
+        INSTRUMENT_COUNT(POSTINGS_REMOVED, words.word_ids.size());
+        document_to_word_freqs_.Clear(ordinal);
+    }
+    // Postings shared with a copy are cloned before the parallel part
+    vector<PostingList*> touched_postings(word_to_document_freqs_.size());
+    for (const int word : touched_words) {
+        touched_postings[word] = &GetMutablePostings(word);
+    }
+    for_each(execution::par, touched_words.begin(), touched_words.end(), [&](int word) {
+        touched_postings[word]->EraseAll(word_ordinals[word]);
+        UpdateWordStatistics(word, -word_term_freqs[word]);
+    });
+}
 
-        for (auto [key_string, value_double] : search_element) {
-            word_to_document_freqs_[key_string].erase(document_id);
+TermSetFingerprint SearchServer::GetTermSetFingerprint(int document_id) const {
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
+        throw out_of_range("document_id out of range"s);
+    }
+    return GetFingerprint(ordinal);
+}
+
+void SearchServer::SetRejectDuplicates(bool reject_duplicates) {
+    reject_duplicates_ = reject_duplicates;
+    live_fingerprint_counts_.clear();
+    if (reject_duplicates_) {
+        for (int ordinal = 0; ordinal < documents_.GetOrdinalCount(); ++ordinal) {
+            if (documents_.IsAlive(ordinal)) {
+                ++live_fingerprint_counts_[GetFingerprint(ordinal)];
+            }
         }
+    }
+}
 
-        document_to_word_freqs_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+void SearchServer::SetNearDuplicateDetection(bool enabled) {
+    near_duplicate_detection_ = enabled;
+    min_hashes_.clear();
+    if (!enabled) {
+        return;
     }
+    // Removed documents are signed too, which keeps signatures addressable by ordinal.
+    // Chunks made by resize aren't shared, so Mutable doesn't touch the chunk table
+    min_hashes_.resize(documents_.GetOrdinalCount());
+    vector<int> ordinals(documents_.GetOrdinalCount());
+    iota(ordinals.begin(), ordinals.end(), 0);
+    for_each(execution::par, ordinals.begin(), ordinals.end(), [this](int ordinal) {
+        ComputeMinHash(document_to_word_freqs_.GetEntries(ordinal).word_ids, min_hashes_.Mutable(ordinal));
+    });
+}
+
+span<const uint32_t> SearchServer::GetMinHashSignature(int document_id) const {
+    if (!near_duplicate_detection_) {
+        throw logic_error("near-duplicate detection is off"s);
+    }
+    const int ordinal = documents_.FindOrdinal(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
+        throw out_of_range("document_id out of range"s);
+    }
+    return min_hashes_[ordinal];
+}
+
+void SearchServer::ValidateNewDocument(int document_id, bool is_duplicate, bool has_valid_text) {
+    if (document_id < 0) {
+        throw invalid_argument("   id"s);
+    }
+    if (is_duplicate) {
+        throw invalid_argument(" c id   "s);
+    }
+    if (!has_valid_text) {
+        throw invalid_argument("  "s);
+    }
+}
+
+void SearchServer::ValidateNewDocumentWords(bool is_duplicate) {
+    if (is_duplicate) {
+        throw invalid_argument("     ,      "s);
+    }
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity, size_t shard_count) {
+    if (capacity == 0) {
+        result_cache_.reset();
+    }
+    else {
+        result_cache_ = make_shared<QueryResultCache>(capacity, shard_count);
+    }
+}
+
+QueryResultCache::Statistics SearchServer::GetResultCacheStatistics() const {
+    return result_cache_ ? result_cache_->GetStatistics() : QueryResultCache::Statistics{};
+}
+
+MemoryStats SearchServer::GetMemoryStats() const {
+    MemoryStats stats;
+    stats.term_dictionary = terms_.GetMemoryUsage();
+    stats.postings = word_to_document_freqs_.GetMemoryUsage() + EstimateMemoryUsage(word_statistics_);
+    // New words share one empty list
+    unordered_set<const PostingList*> counted_postings;
+    for (size_t word = 0; word < word_to_document_freqs_.size(); ++word) {
+        const PostingList& postings = GetPostings(static_cast<int>(word));
+        if (postings.empty()) {
+            ++stats.dead_term_count;
+        }
+        if (counted_postings.insert(&postings).second) {
+            // Lists of a loaded server share one block and control block, see LoadSnapshot
+            stats.postings += sizeof(PostingList) + (snapshot_ ? 0 : SHARED_CONTROL_BLOCK_SIZE) + postings.GetMemoryUsage();
+        }
+    }
+    stats.forward_index = document_to_word_freqs_.GetMemoryUsage();
+    stats.document_table = documents_.GetMemoryUsage();
+    stats.stop_words = EstimateMemoryUsage(stop_words_);
+    stats.duplicate_detection = fingerprints_.GetMemoryUsage() + min_hashes_.GetMemoryUsage()
+        + EstimateMemoryUsage(live_fingerprint_counts_);
+    stats.snapshot_mapping = snapshot_ ? snapshot_->GetBytes().size() : 0;
+    stats.dead_document_count = documents_.GetOrdinalCount() - documents_.size();
+    return stats;
+}
+
+void SearchServer::Compact() {
+    CheckWritable();
+    const vector<int> new_ordinals = documents_.Compact();
+    const int term_count = terms_.GetTermCount();
+    vector<char> is_live_word(term_count);
+    for (int word = 0; word < term_count; ++word) {
+        is_live_word[word] = !GetPostings(word).empty();
+    }
+    const vector<int> new_words = terms_.Compact(is_live_word);
+    // Word ids of cached queries are stale
+    epoch_ = NextEpoch();
+
+    vector<shared_ptr<PostingList>> postings;
+    vector<WordStatistics> word_statistics;
+    postings.reserve(terms_.GetTermCount());
+    word_statistics.reserve(terms_.GetTermCount());
+    for (int word = 0; word < term_count; ++word) {
+        if (is_live_word[word]) {
+            postings.push_back(word_to_document_freqs_[word]);
+            word_statistics.push_back(word_statistics_[word]);
+        }
+    }
+    // Dropping the chunks first leaves only the lists a copy shares with a use count above 1
+    word_to_document_freqs_.clear();
+    word_statistics_ = move(word_statistics);
+    for_each(execution::par, postings.begin(), postings.end(), [&new_ordinals](shared_ptr<PostingList>& list) {
+        GetUnshared(list).Compact(new_ordinals);
+    });
+    for (shared_ptr<PostingList>& list : postings) {
+        word_to_document_freqs_.push_back(move(list));
+    }
+
+    // Live documents keep their order, and so do the words of a document
+    vector<int> old_ordinals(documents_.GetOrdinalCount());
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] != DocumentTable::NO_DOCUMENT) {
+            old_ordinals[new_ordinals[ordinal]] = static_cast<int>(ordinal);
+        }
+    }
+    vector<vector<pair<int, double>>> document_word_freqs(old_ordinals.size());
+    vector<TermSetFingerprint> fingerprints(old_ordinals.size());
+    vector<int> ordinals(old_ordinals.size());
+    iota(ordinals.begin(), ordinals.end(), 0);
+    for_each(execution::par, ordinals.begin(), ordinals.end(), [&](int ordinal) {
+        const ForwardIndex::Entries words = document_to_word_freqs_.GetEntries(old_ordinals[ordinal]);
+        auto& word_freqs = document_word_freqs[ordinal];
+        word_freqs.reserve(words.word_ids.size());
+        for (size_t i = 0; i < words.word_ids.size(); ++i) {
+            const int word = new_words[words.word_ids[i]];
+            word_freqs.emplace_back(word, words.term_freqs[i]);
+            fingerprints[ordinal].Add(word);
+        }
+    });
+    document_to_word_freqs_ = {};
+    fingerprints_.clear();
+    for (size_t ordinal = 0; ordinal < ordinals.size(); ++ordinal) {
+        document_to_word_freqs_.Add(document_word_freqs[ordinal]);
+        fingerprints_.push_back(fingerprints[ordinal]);
+    }
+    SetRejectDuplicates(reject_duplicates_);
+    SetNearDuplicateDetection(near_duplicate_detection_);
+}
+
+void SearchServer::SaveSnapshot(const string& path) const {
+    SnapshotWriter writer(path);
+    writer.WriteValue(SNAPSHOT_MAGIC);
+    writer.WriteValue(SNAPSHOT_VERSION);
+    writer.WriteValue(static_cast<uint32_t>(posting_format_));
+
+    writer.WriteValue<uint64_t>(stop_words_.size());
+    for (const string& stop_word : stop_words_) {
+        writer.WriteArray(span<const char>(stop_word));
+    }
+    terms_.Save(writer);
+    writer.WriteArray(span<const WordStatistics>(word_statistics_));
+    writer.WriteValue<uint64_t>(word_to_document_freqs_.size());
+    for (size_t word = 0; word < word_to_document_freqs_.size(); ++word) {
+        GetPostings(static_cast<int>(word)).Save(writer);
+    }
+
+    document_to_word_freqs_.Save(writer);
+    vector<TermSetFingerprint> fingerprints;
+    for (int ordinal = 0; ordinal < documents_.GetOrdinalCount(); ++ordinal) {
+        fingerprints.push_back(GetFingerprint(ordinal));
+    }
+    writer.WriteArray(span<const TermSetFingerprint>(fingerprints));
+
+    documents_.Save(writer);
+    writer.Finish();
+}
+
+SearchServer SearchServer::LoadSnapshot(const string& path) {
+    auto file = make_shared<const MappedFile>(path);
+    SnapshotReader reader(file->GetBytes());
+    if (reader.ReadValue<uint64_t>() != SNAPSHOT_MAGIC) {
+        throw invalid_argument(path + " is not a search server snapshot"s);
+    }
+    if (reader.ReadValue<uint32_t>() != SNAPSHOT_VERSION) {
+        throw invalid_argument("unsupported snapshot version in "s + path);
+    }
+    const auto posting_format = static_cast<PostingFormat>(reader.ReadValue<uint32_t>());
+    if (posting_format != PostingFormat::FLAT && posting_format != PostingFormat::COMPRESSED) {
+        throw invalid_argument(path + " is inconsistent"s);
+    }
+
+    // Read one by one: a corrupt count runs out of data rather than sizing a vector
+    vector<string_view> stop_words;
+    const uint64_t stop_word_count = reader.ReadValue<uint64_t>();
+    for (uint64_t i = 0; i < stop_word_count; ++i) {
+        const span<const char> text = reader.ReadArray<char>();
+        stop_words.emplace_back(text.data(), text.size());
+    }
+    SearchServer server(stop_words, posting_format);
+    server.snapshot_ = file;
+    server.terms_ = TermDictionary::Load(reader);
+    const span<const WordStatistics> word_statistics = reader.ReadArray<WordStatistics>();
+    server.word_statistics_.assign(word_statistics.begin(), word_statistics.end());
+    const size_t term_count = server.terms_.GetTermCount();
+    if (server.word_statistics_.size() != term_count || reader.ReadValue<uint64_t>() != term_count) {
+        throw invalid_argument(path + " is inconsistent"s);
+    }
+    // All lists live in one block, and every word's pointer aliases its element: a load costs
+    // no heap node per term. A loaded server is read-only, so nothing ever writes through them
+    const auto posting_lists = make_shared<vector<PostingList>>();
+    posting_lists->reserve(term_count);
+    for (size_t word = 0; word < term_count; ++word) {
+        posting_lists->push_back(PostingList::Load(reader));
+    }
+    for (PostingList& postings : *posting_lists) {
+        server.word_to_document_freqs_.push_back(shared_ptr<PostingList>(posting_lists, &postings));
+    }
+    server.document_to_word_freqs_ = ForwardIndex::Load(reader, static_cast<int>(term_count));
+    server.snapshot_fingerprints_ = reader.ReadArray<TermSetFingerprint>();
+    server.documents_ = DocumentTable::Load(reader);
+
+    const int ordinal_count = server.documents_.GetOrdinalCount();
+    if (server.document_to_word_freqs_.GetOrdinalCount() != ordinal_count
+        || server.snapshot_fingerprints_.size() != static_cast<size_t>(ordinal_count)) {
+        throw invalid_argument(path + " is inconsistent"s);
+    }
+    // Postings come before the document table in the file, so their ordinals are checked last
+    for (size_t word = 0; word < term_count; ++word) {
+        server.GetPostings(static_cast<int>(word)).Validate(ordinal_count);
+    }
+    return server;
+}
+
+void SearchServer::CheckWritable() const {
+    if (snapshot_) {
+        throw logic_error("a server loaded from a snapshot is read-only"s);
+    }
+}
+
+uint64_t SearchServer::NextEpoch() {
+    static atomic<uint64_t> last_epoch = 0;
+    return ++last_epoch;
+}
+
+PostingList& SearchServer::GetMutablePostings(int word) {
+    return GetUnshared(word_to_document_freqs_.Mutable(word));
+}
+
+void SearchServer::AddEmptyPostings() {
+    if (word_to_document_freqs_.size() < static_cast<size_t>(terms_.GetTermCount())) {
+        word_to_document_freqs_.resize(terms_.GetTermCount(), make_shared<PostingList>(posting_format_));
+    }
+}
+
+bool SearchServer::DocumentHasWord(int ordinal, int word) const {
+    const span<const int> words = document_to_word_freqs_.GetEntries(ordinal).word_ids;
+    return binary_search(words.begin(), words.end(), word);
+}
+
+TermSetFingerprint SearchServer::GetFingerprint(int ordinal) const {
+    return snapshot_ ? snapshot_fingerprints_[ordinal] : fingerprints_[ordinal];
+}
+
+void SearchServer::AddFingerprint(const TermSetFingerprint& fingerprint) {
+    fingerprints_.push_back(fingerprint);
+    if (reject_duplicates_) {
+        ++live_fingerprint_counts_[fingerprint];
+    }
+}
+
+void SearchServer::ForgetFingerprint(int ordinal) {
+    if (!reject_duplicates_) {
+        return;
+    }
+    const auto it = live_fingerprint_counts_.find(GetFingerprint(ordinal));
+    if (--it->second == 0) {
+        live_fingerprint_counts_.erase(it);
+    }
+}
+
+bool SearchServer::HasLiveDuplicate(const vector<string_view>& words) const {
+    // A word missing from the dictionary can't be in any document
+    vector<int> term_ids;
+    term_ids.reserve(words.size());
+    for (const string_view word : words) {
+        const int term_id = terms_.FindTerm(word);
+        if (term_id == TermDictionary::NO_TERM) {
+            return false;
+        }
+        term_ids.push_back(term_id);
+    }
+    sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    TermSetFingerprint fingerprint;
+    for (const int term_id : term_ids) {
+        fingerprint.Add(term_id);
+    }
+    return live_fingerprint_counts_.count(fingerprint) > 0;
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count((string)word) > 0;
+    return stop_words_.count(word) > 0;
 }
 
 bool SearchServer::IsValidWord(string_view word) {
     // A valid word must not contain special characters
-    return none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-        });
+    return HasNoControlCharacters(word);
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
-    vector<string_view> words;
-    for (auto word : SplitIntoWordsView(text)) {
-        if (!IsValidWord(word)) {
-            throw invalid_argument("  "s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+void SearchServer::RemoveStopWords(vector<string_view>& words) const {
+    if (stop_words_.empty()) {
+        return;
     }
-    return words;
+    erase_if(words, [this](string_view word) {
+        return IsStopWord(word);
+    });
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -190,6 +844,22 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
+// Must be called after the word's postings have been updated
+void SearchServer::UpdateWordStatistics(int word, double term_freq_delta) {
+    WordStatistics& statistics = word_statistics_[word];
+    const size_t document_freq = GetPostings(word).size();
+    if (document_freq == 0) {
+        statistics = {};
+        return;
+    }
+    statistics.log_document_freq = log(static_cast<double>(document_freq));
+    statistics.total_term_freq += term_freq_delta;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(int word, double log_document_count) const {
+    return log_document_count - word_statistics_[word].log_document_freq;
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
     QueryWord result;
 
@@ -209,15 +879,20 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
 }
 
 SearchServer::Query SearchServer::ParseQuery(string_view text) const {
+    INSTRUMENT_PHASE(PARSE_QUERY);
     Query result;
     for (auto word : SplitIntoWordsView(text)) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
+            const int term_id = terms_.FindTerm(query_word.data);
+            if (term_id == TermDictionary::NO_TERM) {
+                continue;
+            }
             if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
+                result.minus_words.push_back(term_id);
             }
             else {
-                result.plus_words.push_back(query_word.data);
+                result.plus_words.push_back(term_id);
             }
         }
     }
@@ -233,15 +908,20 @@ SearchServer::Query SearchServer::ParseQuery(string_view text) const {
 }
 
 SearchServer::Query SearchServer::ParseQueryParallel(string_view text) const {
+    INSTRUMENT_PHASE(PARSE_QUERY);
     Query result;
     for (auto word : SplitIntoWordsView(text)) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
+            const int term_id = terms_.FindTerm(query_word.data);
+            if (term_id == TermDictionary::NO_TERM) {
+                continue;
+            }
             if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
+                result.minus_words.push_back(term_id);
             }
             else {
-                result.plus_words.push_back(query_word.data);
+                result.plus_words.push_back(term_id);
             }
         }
     }
@@ -2,81 +2,288 @@
 
 #include <map>
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include "read_input_functions.h"
 #include "string_processing.h"
 #include "document.h"
+#include "document_filter.h"
+#include "document_page.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "document_table.h"
+#include "forward_index.h"
+#include "top_documents.h"
 #include <execution>
-#include "concurent_map.h"
+#include <memory>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include "relevance_accumulator.h"
+#include "query_result_cache.h"
+#include "term_set_fingerprint.h"
+#include "min_hash.h"
+#include "cow_vector.h"
+#include "instrumentation.h"
+#include <unordered_map>
+
+class MappedFile;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+struct TermStatistics {
+    int document_freq = 0;
+    double inverse_document_freq = 0.0;
+    double total_term_freq = 0.0;
+};
+
+// Estimated heap bytes of a SearchServer by part. Copies share most of the index, and every
+// copy counts the shared parts in full. What a server loaded from a snapshot reads from the
+// mapping isn't counted, snapshot_mapping is the size of the mapping
+struct MemoryStats {
+    size_t term_dictionary = 0;
+    // Posting lists and the statistics of the words
+    size_t postings = 0;
+    size_t forward_index = 0;
+    size_t document_table = 0;
+    size_t stop_words = 0;
+    // Fingerprints of the word sets and MinHash signatures
+    size_t duplicate_detection = 0;
+    size_t snapshot_mapping = 0;
+    // Words without documents and removed documents, which SearchServer::Compact drops
+    int dead_term_count = 0;
+    int dead_document_count = 0;
+
+    // Heap bytes of all parts
+    size_t GetTotal() const noexcept {
+        return term_dictionary + postings + forward_index + document_table + stop_words + duplicate_detection;
+    }
+};
+
+// How FindTopDocuments walks the postings of a query; both find the same documents
+enum class RetrievalMode {
+    // Every posting of every plus word, word by word
+    EXHAUSTIVE,
+    // Document by document, skipping documents whose words can't add up to a place in the
+    // results even with the largest term frequency each word has, in the list or in the
+    // block around the document (block-max MaxScore)
+    MAX_SCORE,
+};
+
+// One document of a batch passed to SearchServer::AddDocuments
+struct DocumentInput {
+    int document_id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Copies are cheap: they share posting lists, forward index chunks, term texts and the
+// result cache with the original, and each side clones what it changes. A copy may be
+// changed while other threads search the original, see ConcurrentSearchServer
 class SearchServer {
 public:
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    explicit SearchServer(const StringContainer& stop_words, PostingFormat posting_format = PostingFormat::FLAT);
 
-    explicit SearchServer(const std::string& stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text))
+    explicit SearchServer(const std::string& stop_words_text, PostingFormat posting_format = PostingFormat::FLAT)
+        : SearchServer(SplitIntoWords(stop_words_text), posting_format)
     {
     }
 
-    explicit SearchServer(std::string_view stop_words_text)
-        : SearchServer(SplitIntoWordsView(stop_words_text))
+    explicit SearchServer(std::string_view stop_words_text, PostingFormat posting_format = PostingFormat::FLAT)
+        : SearchServer(SplitIntoWordsView(stop_words_text), posting_format)
     {
     }
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const  std::vector<int>& ratings);
 
+    // Validates like AddDocument, but the whole batch first: on error nothing is added.
+    // Documents are tokenized into per-slice partial indexes in parallel and merged in one pass
+    void AddDocuments(std::span<const DocumentInput> documents);
+
+    // result_count limits the number of returned documents, best first
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate, size_t result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentStatus status, size_t result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&, std::string_view raw_query, DocumentPredicate document_predicate, size_t result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&, std::string_view raw_query, DocumentStatus status, size_t result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy&, std::string_view raw_query) const;
 
+    // Documents offset to offset + limit - 1 of the ranking FindTopDocuments gives with that
+    // status, and a cursor to the page after them. Costs O(matches * log(offset + limit))
+    DocumentPage FindDocumentsPage(std::string_view raw_query, size_t offset, size_t limit, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    // The limit documents ranked below the last one of the cursor's page, in O(matches * log(limit))
+    DocumentPage FindDocumentsPage(const PageCursor& cursor, size_t limit) const;
+
     int GetDocumentCount() const;
 
-    const std::set<int>::const_iterator begin() const noexcept;
-    const std::set<int>::const_iterator end() const noexcept;
+    // Changes with every change of the index
+    uint64_t GetEpoch() const noexcept {
+        return epoch_;
+    }
+
+    DocumentTable::Iterator begin() const noexcept;
+    DocumentTable::Iterator end() const noexcept;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const;
 
-    const std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+    // Words of the document, sorted by their id, read in place: no allocation. Empty for unknown ids
+    WordFrequencyView GetWordFrequencies(int document_id) const;
+    // The same words, copied to a map ordered by word
+    std::map<std::string_view, double> GetWordFrequencyMap(int document_id) const;
+
+    // All zeros for words that don't occur in any document
+    TermStatistics GetTermStatistics(std::string_view word) const;
 
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
     void RemoveDocument(int document_id);
 
+    // Removes the listed documents with one pass over every affected posting list; unknown ids are skipped
+    void RemoveDocuments(std::span<const int> document_ids);
+
+    // Documents with the same set of words, stop words aside, have the same fingerprint
+    TermSetFingerprint GetTermSetFingerprint(int document_id) const;
+
+    // While on, AddDocument and AddDocuments throw std::invalid_argument for a document with
+    // the same set of words as a live one or as an earlier document of the same batch
+    void SetRejectDuplicates(bool reject_duplicates);
+
+    // While on, every document keeps a MinHash signature of its word set, see FindNearDuplicates.
+    // Turning it on signs the present documents in parallel, later ones are signed as they are added
+    void SetNearDuplicateDetection(bool enabled);
+
+    // MIN_HASH_SIZE entries. Throws std::logic_error while near-duplicate detection is off
+    std::span<const uint32_t> GetMinHashSignature(int document_id) const;
+
+    // Caches results of the FindTopDocuments overloads taking a status, for up to capacity
+    // distinct parsed queries. Every change of the index invalidates the cache; capacity 0
+    // turns it off. Must not be called concurrently with searches
+    void SetResultCacheCapacity(size_t capacity, size_t shard_count = 16);
+    QueryResultCache::Statistics GetResultCacheStatistics() const;
+
+    // MAX_SCORE by default
+    void SetRetrievalMode(RetrievalMode mode);
+    RetrievalMode GetRetrievalMode() const;
+
+    // Writes the best documents with the given status to output, as many as fit, best first.
+    // Returns how many were written
+    size_t WriteTopDocuments(std::string_view raw_query, std::span<Document> output, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    MemoryStats GetMemoryStats() const;
+
+    // Drops words left without documents and the slots of removed documents, renumbering
+    // words and ordinals, repacks the postings and releases spare capacity. Rewrites the whole
+    // index in O(postings), so a copy shares nothing with it afterwards; see
+    // ConcurrentSearchServer::Compact to run it while searches go on. Searches find the same
+    // documents as before, but fingerprints and MinHash signatures change with the word ids
+    void Compact();
+
+    // Writes a versioned binary image of the whole index
+    void SaveSnapshot(const std::string& path) const;
+
+    // Serves the index of a SaveSnapshot file straight from a memory mapping: postings, terms,
+    // the forward index and the document table are read in place. The server is read-only,
+    // adding or removing documents throws std::logic_error
+    static SearchServer LoadSnapshot(const std::string& path);
+
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    const std::set<std::string, std::less<>> stop_words_;
+    const PostingFormat posting_format_;
+    TermDictionary terms_;
+    // Both indexes refer to words by their id in terms_ and to documents by their ordinal in documents_.
+    // Posting lists are shared between copies one by one, use GetMutablePostings to change them
+    CowVector<std::shared_ptr<PostingList>> word_to_document_freqs_;
+    ForwardIndex document_to_word_freqs_;
+    DocumentTable documents_;
+
+    // IDF is log(document_count) - log_document_freq, so a change of the document
+    // count alone doesn't invalidate anything stored per word
+    struct WordStatistics {
+        double log_document_freq = 0.0;
+        double total_term_freq = 0.0;
     };
+    std::vector<WordStatistics> word_statistics_;
+
+    // Fingerprint of every ordinal's word set, computed when the document is added
+    CowVector<TermSetFingerprint> fingerprints_;
+    // Live documents per fingerprint, maintained only while duplicates are rejected
+    bool reject_duplicates_ = false;
+    std::unordered_map<TermSetFingerprint, int, TermSetFingerprintHash> live_fingerprint_counts_;
+    // Signature of every ordinal while near-duplicate detection is on, empty otherwise
+    bool near_duplicate_detection_ = false;
+    CowVector<std::array<uint32_t, MIN_HASH_SIZE>, 64> min_hashes_;
+
+    // Changed by every change of the index. Epochs come from a process-wide counter, so
+    // copies sharing the result cache never reuse each other's
+    uint64_t epoch_ = 0;
+    std::shared_ptr<QueryResultCache> result_cache_;
+    RetrievalMode retrieval_mode_ = RetrievalMode::MAX_SCORE;
+
+    // "SRCHSNAP" in little-endian order, so a snapshot of the other byte order is rejected too
+    static constexpr uint64_t SNAPSHOT_MAGIC = 0x50414E5348435253;
+    static constexpr uint32_t SNAPSHOT_VERSION = 4;
+
+    // Set for servers loaded from a snapshot
+    std::shared_ptr<const MappedFile> snapshot_;
+    std::span<const TermSetFingerprint> snapshot_fingerprints_;
+
+    void CheckWritable() const;
+    static uint64_t NextEpoch();
+
+    const PostingList& GetPostings(int word) const {
+        return *word_to_document_freqs_[word];
+    }
 
-    const std::set<std::string> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    // Clones the word's postings first if a copy of the server shares them
+    PostingList& GetMutablePostings(int word);
+    // New words share one empty list until they get postings
+    void AddEmptyPostings();
+
+    bool DocumentHasWord(int ordinal, int word) const;
+
+    TermSetFingerprint GetFingerprint(int ordinal) const;
+    void AddFingerprint(const TermSetFingerprint& fingerprint);
+    // Called with the ordinal of a document being removed
+    void ForgetFingerprint(int ordinal);
+    // True when the words, already split, are exactly the words of a live document
+    bool HasLiveDuplicate(const std::vector<std::string_view>& words) const;
+
+    // Documents of a batch per parallel slice, at least
+    static constexpr size_t MIN_BATCH_SLICE_SIZE = 256;
+
+    struct PartialIndex;
+
+    // Sets has_valid_text of every document of the slice; documents with control characters are left out
+    void BuildPartialIndex(std::span<const DocumentInput> documents, size_t first, size_t last, PartialIndex& index,
+        std::vector<char>& has_valid_text) const;
+
+    static void ValidateNewDocument(int document_id, bool is_duplicate, bool has_valid_text);
+    static void ValidateNewDocumentWords(bool is_duplicate);
 
     bool IsStopWord(std::string_view word) const;
 
     static bool IsValidWord(std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    void RemoveStopWords(std::vector<std::string_view>& words) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    void UpdateWordStatistics(int word, double term_freq_delta);
+    double ComputeWordInverseDocumentFreq(int word, double log_document_count) const;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
@@ -85,177 +292,375 @@ private:
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Words missing from the dictionary can't match any document and are dropped
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<int> plus_words;
+        std::vector<int> minus_words;
     };
 
     Query ParseQuery(std::string_view text) const;
     Query ParseQueryParallel(std::string_view text) const;
 
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate predicate) const;
-
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate predicate) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsByStatus(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status, size_t result_count) const;
+
+    // Ordinal ranges handled by one task of FindAllDocuments: small enough for the
+    // accumulator to stay in cache, large enough to amortize per-range setup
+    static constexpr int MIN_ORDINAL_RANGE_SIZE = 1 << 12;
+    static constexpr int MAX_ORDINAL_RANGE_SIZE = 1 << 16;
+
+    // Splits the ordinal space into ranges scored independently with private accumulators.
+    // In parallel each range keeps its best result_count documents, and these are merged at the end
+    // With after set, only documents ranked below it are found
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    TopDocuments FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate predicate, size_t result_count,
+        const std::optional<Document>& after = std::nullopt) const;
+
+    // Continues after the last of documents, which start at position first_position, or after
+    // previous, the document ranked just above them, when documents is empty. Without previous
+    // at position 0 the next page starts from the top
+    DocumentPage MakeDocumentPage(std::string_view raw_query, DocumentStatus status, size_t first_position, std::vector<Document> documents,
+        size_t limit, const std::optional<Document>& previous) const;
+
+    // Documents a status filter accepts; empty for other predicates
+    template <typename DocumentPredicate>
+    OrdinalBitmap GetFilterBitmap(const DocumentPredicate& predicate) const {
+        if constexpr (IS_STATUS_FILTER<DocumentPredicate>) {
+            return documents_.GetStatusBitmap(predicate.status);
+        }
+        else {
+            return {};
+        }
+    }
 
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate predicate) const;
+    template <typename DocumentPredicate>
+    void FindDocumentsInRange(const Query& query, const std::vector<double>& idfs, DocumentPredicate& predicate,
+        int first_ordinal, int last_ordinal, TopDocuments& top_documents) const;
+    // Keeps the same documents as FindDocumentsInRange, but doesn't score documents that can't
+    // reach threshold. threshold carries over between the ranges that share top_documents
+    template <typename DocumentPredicate>
+    void FindDocumentsInRangePruned(const Query& query, const std::vector<double>& idfs, DocumentPredicate& predicate,
+        int first_ordinal, int last_ordinal, RelevanceThreshold& threshold, TopDocuments& top_documents) const;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
+SearchServer::SearchServer(const StringContainer& stop_words, PostingFormat posting_format)
     : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    , posting_format_(posting_format)
 {
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
-        throw invalid_argument("   "s);
+    if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+        throw std::invalid_argument("   ");
     }
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t result_count) const {
+    INSTRUMENT_CALL(SEARCH);
     const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, document_predicate);
+    return FindAllDocuments(std::execution::seq, query, document_predicate, result_count).Extract();
+}
 
-    sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            const double EPSILON = 1e-6;
-            if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate, size_t result_count) const {
+    INSTRUMENT_CALL(SEARCH);
+    const Query query = ParseQuery(raw_query);
+    return FindAllDocuments(std::execution::par, query, document_predicate, result_count).Extract();
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy&, std::string_view raw_query, DocumentPredicate document_predicate, size_t result_count) const {
+    return FindTopDocuments(raw_query, document_predicate, result_count);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+TopDocuments SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate predicate, size_t result_count,
+    const std::optional<Document>& after) const {
+    const double log_document_count = std::log(GetDocumentCount());
+    std::vector<double> idfs(query.plus_words.size());
+    std::transform(query.plus_words.begin(), query.plus_words.end(), idfs.begin(),
+        [this, log_document_count](int word) {
+            return ComputeWordInverseDocumentFreq(word, log_document_count);
+        });
+
+    const int ordinal_count = documents_.GetOrdinalCount();
+    TopDocuments top_documents(result_count, after);
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        RelevanceThreshold threshold(result_count);
+        for (int first_ordinal = 0; first_ordinal < ordinal_count; first_ordinal += MAX_ORDINAL_RANGE_SIZE) {
+            const int last_ordinal = std::min(first_ordinal + MAX_ORDINAL_RANGE_SIZE, ordinal_count);
+            if (retrieval_mode_ == RetrievalMode::MAX_SCORE) {
+                FindDocumentsInRangePruned(query, idfs, predicate, first_ordinal, last_ordinal, threshold, top_documents);
             }
             else {
-                return lhs.relevance > rhs.relevance;
+                FindDocumentsInRange(query, idfs, predicate, first_ordinal, last_ordinal, top_documents);
             }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        }
+        return top_documents;
     }
 
-    return matched_documents;
-}
-
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, document_predicate);
-
-    sort(execution::par, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            const double EPSILON = 1e-6;
-            if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
+    const int task_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) * 4);
+    const int range_size = std::clamp(ordinal_count / task_count + 1, MIN_ORDINAL_RANGE_SIZE, MAX_ORDINAL_RANGE_SIZE);
+    std::vector<int> ranges((ordinal_count + range_size - 1) / range_size);
+    std::iota(ranges.begin(), ranges.end(), 0);
+
+    std::vector<TopDocuments> range_documents(ranges.size(), TopDocuments(result_count, after));
+    INSTRUMENT_CAPTURE_CALL(call);
+    std::for_each(policy, ranges.begin(), ranges.end(),
+        [&](int range) {
+            INSTRUMENT_TASK(call);
+            const int first_ordinal = range * range_size;
+            const int last_ordinal = std::min(first_ordinal + range_size, ordinal_count);
+            if (retrieval_mode_ == RetrievalMode::MAX_SCORE) {
+                RelevanceThreshold threshold(result_count);
+                FindDocumentsInRangePruned(query, idfs, predicate, first_ordinal, last_ordinal, threshold, range_documents[range]);
             }
             else {
-                return lhs.relevance > rhs.relevance;
+                FindDocumentsInRange(query, idfs, predicate, first_ordinal, last_ordinal, range_documents[range]);
             }
         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
 
-    return matched_documents;
+    INSTRUMENT_PHASE(SORT);
+    for (TopDocuments& documents : range_documents) {
+        for (const Document& document : documents.Extract()) {
+            top_documents.Add(document);
+        }
+    }
+    return top_documents;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(raw_query, document_predicate);
-}
-
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count((std::string)word) == 0) {
-            continue;
+void SearchServer::FindDocumentsInRange(const Query& query, const std::vector<double>& idfs, DocumentPredicate& predicate,
+    int first_ordinal, int last_ordinal, TopDocuments& top_documents) const {
+    static thread_local RelevanceAccumulator accumulator;
+    accumulator.Reserve(last_ordinal - first_ordinal);
+    // Cleared on every exit, so that a throwing predicate leaves nothing for the next query
+    struct AccumulatorGuard {
+        ~AccumulatorGuard() {
+            accumulator.Clear();
         }
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at((std::string)word)) {
-            const DocumentData documents_data = documents_.at(document_id);
-            if (predicate(document_id, documents_data.status, documents_data.rating)) {
-                const double IDF = log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at((std::string)word).size());
-                document_to_relevance[document_id] += IDF * term_freq;
-            }
+    } accumulator_guard;
+
+    // Counted locally, so that they cost nothing without instrumentation
+    [[maybe_unused]] size_t scanned_count = 0;
+    [[maybe_unused]] size_t filtered_count = 0;
+    [[maybe_unused]] size_t scored_count = 0;
+    [[maybe_unused]] const OrdinalBitmap filter_bitmap = GetFilterBitmap(predicate);
+
+    // Minus words go first so that excluded documents never reach the predicate
+    {
+        INSTRUMENT_PHASE(MINUS_WORDS);
+        for (const int word : query.minus_words) {
+            GetPostings(word).ForEachInRange(first_ordinal, last_ordinal, [first_ordinal, &scanned_count](int ordinal, double) {
+                ++scanned_count;
+                accumulator.Exclude(ordinal - first_ordinal);
+            });
         }
     }
-    for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count((std::string)word) == 0) {
-            continue;
-        }
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at((std::string)word)) {
-            document_to_relevance.erase(document_id);
+    {
+        INSTRUMENT_PHASE(POSTINGS);
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            const double IDF = idfs[i];
+            GetPostings(query.plus_words[i]).ForEachInRange(first_ordinal, last_ordinal,
+                [&, IDF](int ordinal, double term_freq) {
+                    ++scanned_count;
+                    const size_t offset = ordinal - first_ordinal;
+                    if constexpr (IS_STATUS_FILTER<DocumentPredicate>) {
+                        // Filtered by a bit test, before the document is touched
+                        if (!filter_bitmap.Contains(ordinal) || accumulator.IsExcluded(offset)) {
+                            return;
+                        }
+                    }
+                    else {
+                        if (accumulator.IsExcluded(offset)) {
+                            return;
+                        }
+                        // The predicate runs once per document: rejected documents are excluded
+                        if (!accumulator.IsScored(offset)) {
+                            INSTRUMENT_SAMPLED_PHASE(PREDICATE);
+                            if (!predicate(documents_.GetDocumentId(ordinal), documents_.GetStatus(ordinal), documents_.GetRating(ordinal))) {
+                                ++filtered_count;
+                                accumulator.Exclude(offset);
+                                return;
+                            }
+                        }
+                    }
+                    accumulator.Add(offset, IDF * term_freq);
+                });
         }
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
-    }
-    return matched_documents;
+    INSTRUMENT_PHASE(SORT);
+    accumulator.ForEachScored([&](size_t offset, double relevance) {
+        ++scored_count;
+        const int ordinal = first_ordinal + static_cast<int>(offset);
+        top_documents.Add({ documents_.GetDocumentId(ordinal), relevance, documents_.GetRating(ordinal) });
+    });
+    INSTRUMENT_COUNT(POSTINGS_SCANNED, scanned_count);
+    INSTRUMENT_COUNT(DOCUMENTS_FILTERED, filtered_count);
+    INSTRUMENT_COUNT(DOCUMENTS_SCORED, scored_count);
 }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate predicate) const {
-    const size_t BUCKET_SIZE = 6;
-    Concurrentstd::map<int, double> document_to_relevance(BUCKET_SIZE);
-
-    for_each(execution::par, query.plus_words.begin(), query.plus_words.end(),
-        [this, &document_to_relevance]
-        (std::string_view word) {
-            if (word_to_document_freqs_.count((std::string)word)) {
-                for (const auto& [document_id, term_freq] : word_to_document_freqs_.at((std::string)word)) {
-                    const DocumentData documents_data = documents_.at(document_id);
-                    if (predicate(document_id, documents_data.status, documents_data.rating)) {
-                        const double IDF = log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at((std::string)word).size());
-                        document_to_relevance[document_id] += IDF * term_freq;
+template <typename DocumentPredicate>
+void SearchServer::FindDocumentsInRangePruned(const Query& query, const std::vector<double>& idfs, DocumentPredicate& predicate,
+    int first_ordinal, int last_ordinal, RelevanceThreshold& threshold, TopDocuments& top_documents) const {
+    struct TermCursor {
+        PostingList::Cursor cursor;
+        double idf;
+        // Largest contribution the word can make to a relevance
+        double max_score;
+        size_t query_index;
+    };
+    [[maybe_unused]] size_t scanned_count = 0;
+    [[maybe_unused]] size_t filtered_count = 0;
+    [[maybe_unused]] size_t scored_count = 0;
+    [[maybe_unused]] const OrdinalBitmap filter_bitmap = GetFilterBitmap(predicate);
+    {
+        INSTRUMENT_PHASE(POSTINGS);
+        // In query order, which is the order relevances are summed in
+        std::vector<TermCursor> terms;
+        terms.reserve(query.plus_words.size());
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            const PostingList& postings = GetPostings(query.plus_words[i]);
+            if (!postings.empty()) {
+                terms.push_back({ PostingList::Cursor(postings, first_ordinal), idfs[i], idfs[i] * postings.GetMaxTermFreq(), i });
+            }
+        }
+        std::vector<PostingList::Cursor> minus_cursors;
+        minus_cursors.reserve(query.minus_words.size());
+        for (const int word : query.minus_words) {
+            minus_cursors.emplace_back(GetPostings(word), first_ordinal);
+        }
+        const auto is_excluded = [&minus_cursors](int ordinal) {
+            return std::any_of(minus_cursors.begin(), minus_cursors.end(), [ordinal](PostingList::Cursor& cursor) {
+                cursor.SkipTo(ordinal);
+                return cursor.GetDocumentId() == ordinal;
+            });
+        };
+
+        // MaxScore: a document that only the words before essential have can't reach the
+        // threshold, so only the essential words are walked posting by posting
+        std::stable_sort(terms.begin(), terms.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+            return lhs.max_score < rhs.max_score;
+        });
+        std::vector<double> bounds(terms.size());
+        double bound = 0.0;
+        for (size_t i = 0; i < terms.size(); ++i) {
+            bounds[i] = bound += terms[i].max_score;
+        }
+        std::vector<double> contributions(query.plus_words.size());
+        // Twice the epsilon leaves room for relevances summed in another order
+        double min_relevance = threshold.Get() - 2 * TopDocuments::RELEVANCE_EPSILON;
+        size_t essential = 0;
+        while (true) {
+            while (essential < terms.size() && bounds[essential] < min_relevance) {
+                ++essential;
+            }
+            int ordinal = PostingList::Cursor::END;
+            for (size_t i = essential; i < terms.size(); ++i) {
+                ordinal = std::min(ordinal, terms[i].cursor.GetDocumentId());
+            }
+            if (ordinal >= last_ordinal) {
+                break;
+            }
+            if constexpr (IS_STATUS_FILTER<DocumentPredicate>) {
+                // Filtered before any word is scored
+                if (!filter_bitmap.Contains(ordinal)) {
+                    for (size_t i = essential; i < terms.size(); ++i) {
+                        if (terms[i].cursor.GetDocumentId() == ordinal) {
+                            terms[i].cursor.Next();
+                            ++scanned_count;
+                        }
                     }
+                    continue;
                 }
             }
-        }
-    );
-
-    for_each(execution::par, query.minus_words.begin(), query.minus_words.end(),
-        [this, &document_to_relevance]
-        (std::string_view word) {
-            if (word_to_document_freqs_.count((std::string)word)) {
-                for (const auto& [document_id, _] : word_to_document_freqs_.at((std::string)word)) {
-                    document_to_relevance[document_id % BUCKET_SIZE].erase(document_id);
+
+            double partial = 0.0;
+            for (size_t i = essential; i < terms.size(); ++i) {
+                TermCursor& term = terms[i];
+                if (term.cursor.GetDocumentId() == ordinal) {
+                    partial += contributions[term.query_index] = term.idf * term.cursor.GetTermFreq();
+                    term.cursor.Next();
+                    ++scanned_count;
+                }
+            }
+            // The other words, the largest first, while they can still lift the document to the
+            // threshold: with what the block around ordinal holds, before the block is decoded
+            size_t rest = essential;
+            for (; rest > 0; --rest) {
+                TermCursor& term = terms[rest - 1];
+                const double others_bound = partial + (rest > 1 ? bounds[rest - 2] : 0.0);
+                if (others_bound + term.max_score < min_relevance) {
+                    break;
+                }
+                term.cursor.SkipBoundTo(ordinal);
+                if (others_bound + term.idf * term.cursor.GetBoundMaxTermFreq() < min_relevance) {
+                    break;
                 }
+                term.cursor.SkipTo(ordinal);
+                ++scanned_count;
+                if (term.cursor.GetDocumentId() == ordinal) {
+                    partial += contributions[term.query_index] = term.idf * term.cursor.GetTermFreq();
+                }
+            }
+            // Summed in query order, like FindDocumentsInRange does
+            double relevance = 0.0;
+            for (double& contribution : contributions) {
+                relevance += contribution;
+                contribution = 0.0;
+            }
+            if (rest > 0 || relevance < min_relevance || is_excluded(ordinal)) {
+                continue;
             }
+            if constexpr (!IS_STATUS_FILTER<DocumentPredicate>) {
+                INSTRUMENT_SAMPLED_PHASE(PREDICATE);
+                if (!predicate(documents_.GetDocumentId(ordinal), documents_.GetStatus(ordinal), documents_.GetRating(ordinal))) {
+                    ++filtered_count;
+                    continue;
+                }
+            }
+            const Document document(documents_.GetDocumentId(ordinal), relevance, documents_.GetRating(ordinal));
+            // Documents above a page being continued don't count towards the threshold
+            if (!top_documents.Admits(document)) {
+                continue;
+            }
+            threshold.Offer(relevance);
+            min_relevance = threshold.Get() - 2 * TopDocuments::RELEVANCE_EPSILON;
+            ++scored_count;
+            INSTRUMENT_PHASE(SORT);
+            top_documents.Add(document);
         }
-    );
-
-    std::map<int, double> document_to_relevance_reduced = document_to_relevance.BuildOrdinarystd::map();
-    std::vector<Document> matched_documents(document_to_relevance_reduced.size());
-    for (const auto [document_id, relevance] : document_to_relevance_reduced) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
     }
-    return matched_documents;
-
-}
-
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate predicate) const {
-    return FindAllDocuments(query, predicate);
+    INSTRUMENT_COUNT(POSTINGS_SCANNED, scanned_count);
+    INSTRUMENT_COUNT(DOCUMENTS_FILTERED, filtered_count);
+    INSTRUMENT_COUNT(DOCUMENTS_SCORED, scored_count);
 }
 
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (document_to_word_freqs_.count(document_id)) {
-        const std::map<std::string, double>& word_freqs = document_to_word_freqs_.at(document_id);
-        std::vector<std::string*> words(word_freqs.size());
-
-        transform(
-            policy,
-            word_freqs.begin(), word_freqs.end(),
-            words.begin(),
-            [](const auto& item) { return &item.first; }
-        );
-
-        for_each(policy, words.begin(), words.end(), [this, document_id](std::string* item) {
-            word_to_document_freqs_.at(*item).erase(document_id);
-            });
-
-        document_to_word_freqs_.erase(document_id);
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
+    INSTRUMENT_CALL(REMOVE_DOCUMENT);
+    CheckWritable();
+    const int ordinal = documents_.Remove(document_id);
+    if (ordinal == DocumentTable::NO_DOCUMENT) {
+        return;
+    }
+    epoch_ = NextEpoch();
+    ForgetFingerprint(ordinal);
+    const ForwardIndex::Entries words = document_to_word_freqs_.GetEntries(ordinal);
+    // Postings shared with a copy are cloned before the parallel part
+    std::vector<PostingList*> postings;
+    postings.reserve(words.word_ids.size());
+    for (const int word : words.word_ids) {
+        postings.push_back(&GetMutablePostings(word));
     }
+    INSTRUMENT_COUNT(POSTINGS_REMOVED, words.word_ids.size());
+    std::vector<size_t> indexes(words.word_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+
+    std::for_each(policy, indexes.begin(), indexes.end(), [this, ordinal, &words, &postings](size_t i) {
+        postings[i]->Erase(ordinal);
+        UpdateWordStatistics(words.word_ids[i], -words.term_freqs[i]);
+        });
+
+    document_to_word_freqs_.Clear(ordinal);
 }
\ No newline at end of file
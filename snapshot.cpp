@@ -0,0 +1,137 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string& path) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        throw runtime_error("cannot open "s + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+        CloseHandle(file_);
+        throw runtime_error("cannot get the size of "s + path);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0) {
+        return;
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        CloseHandle(file_);
+        throw runtime_error("cannot map "s + path);
+    }
+    data_ = static_cast<const byte*>(view);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    if (file_) {
+        CloseHandle(file_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const string& path) {
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw runtime_error("cannot open "s + path);
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        throw runtime_error("cannot get the size of "s + path);
+    }
+    size_ = static_cast<size_t>(status.st_size);
+    if (size_ > 0) {
+        void* view = mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (view == MAP_FAILED) {
+            close(descriptor);
+            throw runtime_error("cannot map "s + path);
+        }
+        data_ = static_cast<const byte*>(view);
+    }
+    // The mapping stays valid without the descriptor
+    close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<byte*>(data_), size_);
+    }
+}
+
+#endif
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : out_(path, ios::binary | ios::trunc) {
+    if (!out_) {
+        throw runtime_error("cannot create "s + path);
+    }
+}
+
+void SnapshotWriter::Finish() {
+    out_.flush();
+    if (!out_) {
+        throw runtime_error("failed to write the snapshot"s);
+    }
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    offset_ += size;
+}
+
+void SnapshotWriter::Align(size_t alignment) {
+    static const char PADDING[ALIGNMENT] = {};
+    Write(PADDING, (alignment - offset_ % alignment) % alignment);
+}
+
+SnapshotReader::SnapshotReader(span<const byte> bytes)
+    : bytes_(bytes) {
+}
+
+void SnapshotReader::Read(void* data, size_t size) {
+    memcpy(data, Skip(size, 1), size);
+}
+
+const byte* SnapshotReader::Skip(uint64_t count, size_t element_size) {
+    const size_t left = bytes_.size() - offset_;
+    if (count > left / element_size) {
+        throw invalid_argument("snapshot is truncated"s);
+    }
+    const byte* data = bytes_.data() + offset_;
+    offset_ += static_cast<size_t>(count) * element_size;
+    return data;
+}
+
+void SnapshotReader::Align(size_t alignment) {
+    const size_t padding = (alignment - offset_ % alignment) % alignment;
+    Skip(padding, 1);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <type_traits>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const std::byte> GetBytes() const noexcept {
+        return { data_, size_ };
+    }
+
+private:
+    const std::byte* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+// Writes values and length-prefixed arrays of trivially copyable types in native byte order.
+// Arrays start at 8-byte aligned offsets, so a reader over a mapping can hand them out in place
+class SnapshotWriter {
+public:
+    static constexpr size_t ALIGNMENT = 8;
+
+    explicit SnapshotWriter(const std::string& path);
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= ALIGNMENT);
+        Align(alignof(T));
+        Write(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void WriteArray(std::span<const T> values) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= ALIGNMENT);
+        WriteValue<uint64_t>(values.size());
+        Align(ALIGNMENT);
+        Write(values.data(), values.size_bytes());
+    }
+
+    // Flushes the file; throws if anything failed to be written
+    void Finish();
+
+private:
+    std::ofstream out_;
+    uint64_t offset_ = 0;
+
+    void Write(const void* data, size_t size);
+    void Align(size_t alignment);
+};
+
+// Reads what SnapshotWriter wrote. Arrays are views into the underlying bytes
+class SnapshotReader {
+public:
+    explicit SnapshotReader(std::span<const std::byte> bytes);
+
+    template <typename T>
+    T ReadValue() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Align(alignof(T));
+        T value;
+        Read(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    std::span<const T> ReadArray() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint64_t count = ReadValue<uint64_t>();
+        Align(SnapshotWriter::ALIGNMENT);
+        const std::byte* data = Skip(count, sizeof(T));
+        return { reinterpret_cast<const T*>(data), static_cast<size_t>(count) };
+    }
+
+private:
+    std::span<const std::byte> bytes_;
+    size_t offset_ = 0;
+
+    void Read(void* data, size_t size);
+    const std::byte* Skip(uint64_t count, size_t element_size);
+    void Align(size_t alignment);
+};
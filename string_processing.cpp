@@ -1,4 +1,5 @@
 #include "string_processing.h"
+#include "tokenizer.h"
 
 using namespace std;
 
@@ -25,6 +26,11 @@ vector<string> SplitIntoWords(const string& text) {
 
 vector<string_view> SplitIntoWordsView(string_view str) {
     vector<string_view> result;
+    if (TokenizeWords(str, result)) {
+        return result;
+    }
+    // Text with control characters is still split: rejecting its words is up to the caller
+    result.clear();
     str.remove_prefix(min(str.find_first_not_of(' '), str.size()));
     const string_view::size_type pos_end = string_view::npos;
 
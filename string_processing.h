@@ -13,8 +13,8 @@ std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
 std::map<std::string_view, double> StringViewFy(const std::map<std::string, double>& inp);
 
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
     for (auto str_view : strings) {
         std::string str{ str_view };
         if (!str.empty()) {
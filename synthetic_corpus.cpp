@@ -0,0 +1,170 @@
+#include "synthetic_corpus.h"
+#include "string_processing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+class CorpusRandom {
+public:
+    explicit CorpusRandom(uint64_t seed)
+        : generator_(seed) {
+    }
+
+    // Uniform in [0, 1), from the top 53 bits
+    double NextUnit() {
+        return static_cast<double>(generator_() >> 11) * 0x1.0p-53;
+    }
+
+    // Uniform in [first, last]
+    int NextInt(int first, int last) {
+        return first + static_cast<int>(generator_() % (static_cast<uint64_t>(last - first) + 1));
+    }
+
+    bool NextBool(double probability) {
+        return NextUnit() < probability;
+    }
+
+private:
+    mt19937_64 generator_;
+};
+
+// Cumulative Zipf weights of the ranks, normalized to end at 1
+vector<double> ComputeZipfDistribution(int vocabulary_size, double exponent) {
+    vector<double> cumulative(vocabulary_size);
+    double sum = 0.0;
+    for (int rank = 0; rank < vocabulary_size; ++rank) {
+        sum += 1.0 / pow(rank + 1, exponent);
+        cumulative[rank] = sum;
+    }
+    for (double& weight : cumulative) {
+        weight /= sum;
+    }
+    return cumulative;
+}
+
+class WordSampler {
+public:
+    WordSampler(const SyntheticCorpusOptions& options, CorpusRandom& random)
+        : options_(options)
+        , random_(random)
+        , zipf_(ComputeZipfDistribution(options.vocabulary_size, options.zipf_exponent)) {
+    }
+
+    bool NextIsStopWord() {
+        return options_.stop_word_count > 0 && random_.NextBool(options_.stop_word_ratio);
+    }
+
+    string NextStopWord() {
+        return "s"s + to_string(random_.NextInt(0, options_.stop_word_count - 1));
+    }
+
+    string NextContentWord() {
+        const auto it = upper_bound(zipf_.begin(), zipf_.end(), random_.NextUnit());
+        return "w"s + to_string(min(it - zipf_.begin(), static_cast<ptrdiff_t>(zipf_.size() - 1)));
+    }
+
+    string NextWord() {
+        return NextIsStopWord() ? NextStopWord() : NextContentWord();
+    }
+
+private:
+    const SyntheticCorpusOptions& options_;
+    CorpusRandom& random_;
+    vector<double> zipf_;
+};
+
+DocumentStatus NextStatus(CorpusRandom& random) {
+    const double value = random.NextUnit();
+    if (value < 0.8) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (value < 0.9) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    return value < 0.95 ? DocumentStatus::BANNED : DocumentStatus::REMOVED;
+}
+
+void CheckOptions(const SyntheticCorpusOptions& options) {
+    if (options.document_count < 0 || options.query_count < 0 || options.vocabulary_size <= 0 || options.stop_word_count < 0
+        || options.min_document_length <= 0 || options.min_document_length > options.max_document_length
+        || options.min_query_length <= 0 || options.min_query_length > options.max_query_length) {
+        throw invalid_argument("некорректные параметры синтетического корпуса"s);
+    }
+}
+
+}
+
+SyntheticCorpus GenerateSyntheticCorpus(const SyntheticCorpusOptions& options) {
+    CheckOptions(options);
+    CorpusRandom random(options.seed);
+    WordSampler sampler(options, random);
+    SyntheticCorpus corpus;
+
+    for (int i = 0; i < options.stop_word_count; ++i) {
+        corpus.stop_words += "s"s + to_string(i) + ' ';
+    }
+
+    corpus.documents.reserve(options.document_count);
+    vector<string> words;
+    for (int document_id = 0; document_id < options.document_count; ++document_id) {
+        words.clear();
+        if (document_id > 0 && random.NextBool(options.duplicate_ratio)) {
+            const string& original = corpus.documents[random.NextInt(0, document_id - 1)].text;
+            for (const string_view word : SplitIntoWordsView(original)) {
+                words.emplace_back(word);
+            }
+            // Fisher-Yates, spelled out so that the order is the same everywhere
+            for (size_t i = words.size(); i > 1; --i) {
+                swap(words[i - 1], words[random.NextInt(0, static_cast<int>(i) - 1)]);
+            }
+        }
+        else {
+            const int length = random.NextInt(options.min_document_length, options.max_document_length);
+            for (int i = 0; i < length; ++i) {
+                words.push_back(sampler.NextWord());
+            }
+        }
+
+        SyntheticDocument document;
+        document.document_id = document_id;
+        for (const string& word : words) {
+            if (!document.text.empty()) {
+                document.text += ' ';
+            }
+            document.text += word;
+        }
+        document.status = NextStatus(random);
+        document.ratings.resize(random.NextInt(1, 5));
+        for (int& rating : document.ratings) {
+            rating = random.NextInt(-10, 10);
+        }
+        corpus.documents.push_back(move(document));
+    }
+
+    corpus.queries.reserve(options.query_count);
+    for (int i = 0; i < options.query_count; ++i) {
+        const int length = random.NextInt(options.min_query_length, options.max_query_length);
+        string query;
+        for (int j = 0; j < length; ++j) {
+            if (!query.empty()) {
+                query += ' ';
+            }
+            if (sampler.NextIsStopWord()) {
+                query += sampler.NextStopWord();
+                continue;
+            }
+            if (random.NextBool(options.minus_word_ratio)) {
+                query += '-';
+            }
+            query += sampler.NextContentWord();
+        }
+        corpus.queries.push_back(move(query));
+    }
+    return corpus;
+}
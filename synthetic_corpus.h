@@ -0,0 +1,49 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Words follow a Zipf law over the vocabulary: the word of rank r comes up in proportion to
+// 1 / r^zipf_exponent. Content words are "w<rank>", stop words "s<index>"
+struct SyntheticCorpusOptions {
+    uint64_t seed = 1;
+    int document_count = 100'000;
+    int vocabulary_size = 50'000;
+    double zipf_exponent = 1.0;
+    int min_document_length = 20;
+    int max_document_length = 60;
+    int stop_word_count = 50;
+    // Share of the words of documents and queries that are stop words
+    double stop_word_ratio = 0.2;
+    // Share of documents that repeat the words of an earlier one in another order
+    double duplicate_ratio = 0.05;
+    int query_count = 2'000;
+    int min_query_length = 1;
+    int max_query_length = 5;
+    // Share of the content words of queries that are minus words
+    double minus_word_ratio = 0.1;
+};
+
+struct SyntheticDocument {
+    int document_id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+struct SyntheticCorpus {
+    // Space-separated, for the SearchServer constructor
+    std::string stop_words;
+    // Ids from 0 in order
+    std::vector<SyntheticDocument> documents;
+    std::vector<std::string> queries;
+};
+
+// The same options give the same corpus on every run and platform: the random numbers come
+// straight from mt19937_64, whose output the standard fixes, rather than from the standard
+// distributions, whose algorithms it leaves to the library. Only a rounding difference of
+// pow in the Zipf weights could still move a word to the neighbouring rank
+SyntheticCorpus GenerateSyntheticCorpus(const SyntheticCorpusOptions& options);
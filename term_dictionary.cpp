@@ -0,0 +1,125 @@
+#include "term_dictionary.h"
+#include "memory_usage.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+int TermDictionary::AddTerm(string_view term) {
+    if (is_mapped_) {
+        throw logic_error("a dictionary loaded from a snapshot is read-only"s);
+    }
+    if (const auto it = term_to_id_.find(term); it != term_to_id_.end()) {
+        return it->second;
+    }
+    string_view stored;
+    {
+        lock_guard lock(storage_->mutex);
+        stored = storage_->terms.emplace_back(term);
+    }
+    const int term_id = static_cast<int>(terms_.size());
+    terms_.push_back(stored);
+    term_to_id_.emplace(stored, term_id);
+    return term_id;
+}
+
+int TermDictionary::FindTerm(string_view term) const {
+    if (is_mapped_) {
+        const auto it = lower_bound(mapped_sorted_ids_.begin(), mapped_sorted_ids_.end(), term,
+            [this](int term_id, string_view term) {
+                return GetTerm(term_id) < term;
+            });
+        return it != mapped_sorted_ids_.end() && GetTerm(*it) == term ? *it : NO_TERM;
+    }
+    const auto it = term_to_id_.find(term);
+    return it == term_to_id_.end() ? NO_TERM : it->second;
+}
+
+string_view TermDictionary::GetTerm(int term_id) const {
+    if (is_mapped_) {
+        if (term_id < 0 || term_id >= GetTermCount()) {
+            throw out_of_range("term id out of range"s);
+        }
+        const uint64_t begin = mapped_offsets_[term_id];
+        return { mapped_text_.data() + begin, static_cast<size_t>(mapped_offsets_[term_id + 1] - begin) };
+    }
+    return terms_.at(term_id);
+}
+
+int TermDictionary::GetTermCount() const {
+    if (is_mapped_) {
+        return static_cast<int>(mapped_offsets_.size()) - 1;
+    }
+    return static_cast<int>(terms_.size());
+}
+
+vector<int> TermDictionary::Compact(span<const char> is_live) {
+    if (is_mapped_) {
+        throw logic_error("a dictionary loaded from a snapshot is read-only"s);
+    }
+    vector<int> new_ids(terms_.size(), NO_TERM);
+    TermDictionary compacted;
+    compacted.terms_.reserve(count(is_live.begin(), is_live.end(), 1));
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (is_live[term_id]) {
+            new_ids[term_id] = compacted.AddTerm(terms_[term_id]);
+        }
+    }
+    *this = move(compacted);
+    return new_ids;
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    size_t usage = EstimateMemoryUsage(terms_) + EstimateMemoryUsage(term_to_id_);
+    lock_guard lock(storage_->mutex);
+    usage += storage_->terms.size() * sizeof(string);
+    for (const string& term : storage_->terms) {
+        usage += EstimateMemoryUsage(term);
+    }
+    return usage;
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    const int term_count = GetTermCount();
+    string text;
+    vector<uint64_t> offsets = { 0 };
+    for (int term_id = 0; term_id < term_count; ++term_id) {
+        text += GetTerm(term_id);
+        offsets.push_back(text.size());
+    }
+    vector<int> sorted_ids(term_count);
+    iota(sorted_ids.begin(), sorted_ids.end(), 0);
+    sort(sorted_ids.begin(), sorted_ids.end(), [this](int lhs, int rhs) {
+        return GetTerm(lhs) < GetTerm(rhs);
+    });
+
+    writer.WriteArray(span<const char>(text));
+    writer.WriteArray(span<const uint64_t>(offsets));
+    writer.WriteArray(span<const int>(sorted_ids));
+}
+
+TermDictionary TermDictionary::Load(SnapshotReader& reader) {
+    TermDictionary dictionary;
+    dictionary.is_mapped_ = true;
+    dictionary.mapped_text_ = reader.ReadArray<char>();
+    dictionary.mapped_offsets_ = reader.ReadArray<uint64_t>();
+    dictionary.mapped_sorted_ids_ = reader.ReadArray<int>();
+    const span<const uint64_t> offsets = dictionary.mapped_offsets_;
+    const span<const int> sorted_ids = dictionary.mapped_sorted_ids_;
+    if (offsets.empty() || offsets.front() != 0 || offsets.back() != dictionary.mapped_text_.size()
+        || sorted_ids.size() + 1 != offsets.size() || !is_sorted(offsets.begin(), offsets.end())) {
+        throw invalid_argument("snapshot term dictionary is inconsistent"s);
+    }
+    // FindTerm searches sorted_ids, so it must list every id once, in the order of the terms
+    const int term_count = dictionary.GetTermCount();
+    for (size_t i = 0; i < sorted_ids.size(); ++i) {
+        if (sorted_ids[i] < 0 || sorted_ids[i] >= term_count
+            || (i > 0 && dictionary.GetTerm(sorted_ids[i - 1]) >= dictionary.GetTerm(sorted_ids[i]))) {
+            throw invalid_argument("snapshot term dictionary is inconsistent"s);
+        }
+    }
+    return dictionary;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Stores every distinct word once and maps it to a dense integer id.
+// Ids are assigned in order of first appearance, starting from zero,
+// and string_views returned by GetTerm stay valid for the dictionary lifetime
+// or until Compact.
+// Copies share the text of the terms, so copying costs the id tables only.
+// A dictionary loaded from a snapshot looks terms up by binary search over the
+// mapping and can't take new terms.
+class TermDictionary {
+public:
+    static constexpr int NO_TERM = -1;
+
+    int AddTerm(std::string_view term);
+
+    int FindTerm(std::string_view term) const;
+
+    std::string_view GetTerm(int term_id) const;
+
+    int GetTermCount() const;
+
+    // Keeps the terms with is_live set, renumbered 0, 1, ... in their order, and moves them
+    // to storage of their own. Returns the new id of every old one, NO_TERM for dropped terms
+    std::vector<int> Compact(std::span<const char> is_live);
+
+    // Heap bytes, the text of terms that copies added to the shared storage included
+    size_t GetMemoryUsage() const;
+
+    void Save(SnapshotWriter& writer) const;
+    // The mapping behind reader must outlive the dictionary
+    static TermDictionary Load(SnapshotReader& reader);
+
+private:
+    // Only grows. Copies append under the mutex, and views into it stay valid while any copy lives
+    struct Storage {
+        std::mutex mutex;
+        std::deque<std::string> terms;
+    };
+
+    std::shared_ptr<Storage> storage_ = std::make_shared<Storage>();
+    std::vector<std::string_view> terms_;
+    std::unordered_map<std::string_view, int> term_to_id_;
+
+    // Snapshot: concatenated terms, where term i spans [offsets[i], offsets[i + 1]), and ids in term order
+    bool is_mapped_ = false;
+    std::span<const char> mapped_text_;
+    std::span<const uint64_t> mapped_offsets_;
+    std::span<const int> mapped_sorted_ids_;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 128-bit hash of a document's set of term ids: two differently seeded 64-bit hashes
+// folded over the ids in ascending order. Equal sets give equal fingerprints, different
+// sets collide with probability around 2^-128, so fingerprints stand in for the sets
+struct TermSetFingerprint {
+    uint64_t low = LOW_SEED;
+    uint64_t high = HIGH_SEED;
+
+    // Term ids must be added in ascending order, each once
+    void Add(int term_id) noexcept {
+        const uint64_t term = static_cast<uint32_t>(term_id);
+        low = Mix(low ^ (term + LOW_SEED));
+        high = Mix(high + term * HIGH_MULTIPLIER);
+    }
+
+    bool operator==(const TermSetFingerprint&) const = default;
+
+private:
+    static constexpr uint64_t LOW_SEED = 0x9E3779B97F4A7C15;
+    static constexpr uint64_t HIGH_SEED = 0xC2B2AE3D27D4EB4F;
+    static constexpr uint64_t HIGH_MULTIPLIER = 0x165667B19E3779F9;
+
+    // splitmix64 finalizer
+    static uint64_t Mix(uint64_t x) noexcept {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+        return x ^ (x >> 31);
+    }
+};
+
+struct TermSetFingerprintHash {
+    size_t operator()(const TermSetFingerprint& fingerprint) const noexcept {
+        return static_cast<size_t>(fingerprint.low);
+    }
+};
@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// Pool and queue index of the worker running on this thread
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+}
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : queues_(max<size_t>(thread_count, 1)) {
+    threads_.reserve(queues_.size());
+    for (size_t index = 0; index < queues_.size(); ++index) {
+        threads_.emplace_back([this, index] {
+            RunWorker(index);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard guard(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (thread& worker : threads_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(function<void()> task) {
+    const size_t index = IsWorkerThread()
+        ? current_queue
+        : next_queue_.fetch_add(1, memory_order_relaxed) % queues_.size();
+    {
+        lock_guard guard(queues_[index].mutex);
+        queues_[index].tasks.push_back(move(task));
+    }
+    queued_count_.fetch_add(1);
+    // Taking the mutex orders the increment before a worker's check and its wait
+    {
+        lock_guard guard(wake_mutex_);
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::RunPendingTask() {
+    function<void()> task;
+    if (!TryTake(IsWorkerThread() ? current_queue : 0, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+bool ThreadPool::IsWorkerThread() const noexcept {
+    return current_pool == this;
+}
+
+void ThreadPool::RunWorker(size_t index) {
+    current_pool = this;
+    current_queue = index;
+    function<void()> task;
+    while (true) {
+        if (TryTake(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        unique_lock lock(wake_mutex_);
+        wake_.wait(lock, [this] {
+            return queued_count_.load() > 0 || stopping_;
+        });
+        if (stopping_ && queued_count_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryTake(size_t index, function<void()>& task) {
+    if (queued_count_.load() == 0) {
+        return false;
+    }
+    {
+        WorkerQueue& own = queues_[index];
+        lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_count_.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        WorkerQueue& victim = queues_[(index + offset) % queues_.size()];
+        lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_count_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+ThreadPool& GetDefaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers with a task deque each. A worker takes its own newest
+// task first and, when it runs dry, steals the oldest task of another worker.
+// Tasks submitted from a worker go to its own deque, others are spread round-robin.
+// Tasks must not throw.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+
+    // Runs the remaining tasks, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> task);
+
+    // Runs one queued task on the calling thread, if there is any. Lets a thread
+    // that waits for tasks of this pool help instead of blocking a worker
+    bool RunPendingTask();
+
+    // True when called from one of this pool's workers
+    bool IsWorkerThread() const noexcept;
+
+    size_t GetThreadCount() const noexcept {
+        return threads_.size();
+    }
+
+private:
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<WorkerQueue> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_count_ = 0;
+    std::atomic<size_t> next_queue_ = 0;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    void RunWorker(size_t index);
+    bool TryTake(size_t index, std::function<void()>& task);
+};
+
+// Pool with one worker per hardware thread, created on first use
+ThreadPool& GetDefaultThreadPool();
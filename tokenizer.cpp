@@ -0,0 +1,258 @@
+#include "tokenizer.h"
+
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TOKENIZER_X86_64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr unsigned char LAST_CONTROL_CHARACTER = ' ' - 1;
+
+// Word boundaries found so far. Chunks report which of their bytes belong to words;
+// every change between word and space bytes starts or ends a word
+class WordSplitter {
+public:
+    WordSplitter(string_view text, vector<string_view>& words)
+        : text_(text)
+        , words_(words) {
+        words_.clear();
+    }
+
+    // Bit i of word_bits is set when byte position + i is not a space; chunk_size is at most 64
+    void AddChunk(size_t position, uint64_t word_bits, size_t chunk_size) {
+        uint64_t transitions = word_bits ^ ((word_bits << 1) | static_cast<uint64_t>(in_word_));
+        if (chunk_size < 64) {
+            transitions &= (uint64_t{ 1 } << chunk_size) - 1;
+        }
+        while (transitions != 0) {
+            Toggle(position + countr_zero(transitions));
+            transitions &= transitions - 1;
+        }
+    }
+
+    // Scalar path for the bytes no chunk covers. Returns false on a control character
+    bool AddBytes(size_t first, size_t last) {
+        for (size_t position = first; position < last; ++position) {
+            const auto c = static_cast<unsigned char>(text_[position]);
+            if (c <= LAST_CONTROL_CHARACTER) {
+                return false;
+            }
+            if ((c != ' ') != in_word_) {
+                Toggle(position);
+            }
+        }
+        return true;
+    }
+
+    void Finish() {
+        if (in_word_) {
+            Toggle(text_.size());
+        }
+    }
+
+private:
+    string_view text_;
+    vector<string_view>& words_;
+    size_t word_start_ = 0;
+    bool in_word_ = false;
+
+    void Toggle(size_t position) {
+        if (in_word_) {
+            words_.push_back(text_.substr(word_start_, position - word_start_));
+        }
+        else {
+            word_start_ = position;
+        }
+        in_word_ = !in_word_;
+    }
+};
+
+bool TokenizeScalar(string_view text, vector<string_view>& words) {
+    WordSplitter splitter(text, words);
+    if (!splitter.AddBytes(0, text.size())) {
+        return false;
+    }
+    splitter.Finish();
+    return true;
+}
+
+bool HasNoControlCharactersScalar(string_view text) {
+    for (const char c : text) {
+        if (static_cast<unsigned char>(c) <= LAST_CONTROL_CHARACTER) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef TOKENIZER_X86_64
+
+// SSE2 is part of x86-64, so this path needs no detection
+bool TokenizeSse2(string_view text, vector<string_view>& words) {
+    WordSplitter splitter(text, words);
+    const __m128i last_control = _mm_set1_epi8(LAST_CONTROL_CHARACTER);
+    const __m128i space = _mm_set1_epi8(' ');
+    size_t position = 0;
+    for (; position + 16 <= text.size(); position += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+        // Unsigned bytes <= last_control are exactly those unchanged by max(bytes, last_control)
+        const __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, last_control), last_control);
+        if (_mm_movemask_epi8(control) != 0) {
+            return false;
+        }
+        const auto spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)));
+        splitter.AddChunk(position, ~spaces & 0xFFFF, 16);
+    }
+    if (!splitter.AddBytes(position, text.size())) {
+        return false;
+    }
+    splitter.Finish();
+    return true;
+}
+
+bool HasNoControlCharactersSse2(string_view text) {
+    const __m128i last_control = _mm_set1_epi8(LAST_CONTROL_CHARACTER);
+    size_t position = 0;
+    for (; position + 16 <= text.size(); position += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(bytes, last_control), last_control)) != 0) {
+            return false;
+        }
+    }
+    return HasNoControlCharactersScalar(text.substr(position));
+}
+
+TARGET_AVX2 bool TokenizeAvx2(string_view text, vector<string_view>& words) {
+    WordSplitter splitter(text, words);
+    const __m256i last_control = _mm256_set1_epi8(LAST_CONTROL_CHARACTER);
+    const __m256i space = _mm256_set1_epi8(' ');
+    size_t position = 0;
+    // Two vectors per step fill all 64 bits of a chunk
+    for (; position + 64 <= text.size(); position += 64) {
+        const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position));
+        const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position + 32));
+        const __m256i control = _mm256_or_si256(
+            _mm256_cmpeq_epi8(_mm256_max_epu8(low, last_control), last_control),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(high, last_control), last_control));
+        if (_mm256_movemask_epi8(control) != 0) {
+            return false;
+        }
+        const uint64_t spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, space)))
+            | static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, space)))) << 32;
+        splitter.AddChunk(position, ~spaces, 64);
+    }
+    if (!splitter.AddBytes(position, text.size())) {
+        return false;
+    }
+    splitter.Finish();
+    return true;
+}
+
+TARGET_AVX2 bool HasNoControlCharactersAvx2(string_view text) {
+    const __m256i last_control = _mm256_set1_epi8(LAST_CONTROL_CHARACTER);
+    size_t position = 0;
+    for (; position + 32 <= text.size(); position += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(bytes, last_control), last_control)) != 0) {
+            return false;
+        }
+    }
+    return HasNoControlCharactersScalar(text.substr(position));
+}
+
+bool CpuSupportsAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    const bool has_avx = (info[2] & (1 << 28)) != 0;
+    // The OS must save the upper halves of the registers too
+    if (!has_osxsave || !has_avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+TokenizerIsa DetectIsa() {
+#ifdef TOKENIZER_X86_64
+    return CpuSupportsAvx2() ? TokenizerIsa::AVX2 : TokenizerIsa::SSE2;
+#else
+    return TokenizerIsa::SCALAR;
+#endif
+}
+
+bool Tokenize(string_view text, vector<string_view>& words, TokenizerIsa isa) {
+    switch (isa) {
+#ifdef TOKENIZER_X86_64
+    case TokenizerIsa::AVX2:
+        return TokenizeAvx2(text, words);
+    case TokenizerIsa::SSE2:
+        return TokenizeSse2(text, words);
+#endif
+    default:
+        return TokenizeScalar(text, words);
+    }
+}
+
+bool CheckControlCharacters(string_view text, TokenizerIsa isa) {
+    switch (isa) {
+#ifdef TOKENIZER_X86_64
+    case TokenizerIsa::AVX2:
+        return HasNoControlCharactersAvx2(text);
+    case TokenizerIsa::SSE2:
+        return HasNoControlCharactersSse2(text);
+#endif
+    default:
+        return HasNoControlCharactersScalar(text);
+    }
+}
+
+void CheckSupported(TokenizerIsa isa) {
+    if (isa > GetTokenizerIsa()) {
+        throw invalid_argument("the CPU doesn't support this instruction set"s);
+    }
+}
+
+}
+
+TokenizerIsa GetTokenizerIsa() {
+    static const TokenizerIsa isa = DetectIsa();
+    return isa;
+}
+
+bool TokenizeWords(string_view text, vector<string_view>& words) {
+    return Tokenize(text, words, GetTokenizerIsa());
+}
+
+bool HasNoControlCharacters(string_view text) {
+    return CheckControlCharacters(text, GetTokenizerIsa());
+}
+
+bool TokenizeWords(string_view text, vector<string_view>& words, TokenizerIsa isa) {
+    CheckSupported(isa);
+    return Tokenize(text, words, isa);
+}
+
+bool HasNoControlCharacters(string_view text, TokenizerIsa isa) {
+    CheckSupported(isa);
+    return CheckControlCharacters(text, isa);
+}
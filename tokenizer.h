@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+// Instruction sets the tokenizer has an implementation for, best last
+enum class TokenizerIsa {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Best instruction set this CPU supports, detected at the first call
+TokenizerIsa GetTokenizerIsa();
+
+// Splits text into words separated by spaces and checks that it has no control characters
+// (bytes below ' ') in the same pass. words is cleared first, so a buffer reused between
+// calls stops allocating. Returns false at the first control character, leaving words partial
+bool TokenizeWords(std::string_view text, std::vector<std::string_view>& words);
+
+// True when text has no control characters
+bool HasNoControlCharacters(std::string_view text);
+
+// Versions for an explicit instruction set; throw std::invalid_argument if the CPU lacks it
+bool TokenizeWords(std::string_view text, std::vector<std::string_view>& words, TokenizerIsa isa);
+bool HasNoControlCharacters(std::string_view text, TokenizerIsa isa);
@@ -0,0 +1,84 @@
+#include "top_documents.h"
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+using namespace std;
+
+TopDocuments::TopDocuments(size_t capacity, const optional<Document>& after)
+    : capacity_(capacity)
+    , after_(after) {
+}
+
+void TopDocuments::Add(const Document& document) {
+    if (!Admits(document)) {
+        return;
+    }
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsBetter);
+    }
+    else if (capacity_ > 0 && IsBetter(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsBetter);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsBetter);
+    }
+}
+
+vector<Document> TopDocuments::Extract() {
+    INSTRUMENT_PHASE(SORT);
+    sort_heap(heap_.begin(), heap_.end(), IsBetter);
+    vector<Document> documents = move(heap_);
+    heap_.clear();
+    return documents;
+}
+
+size_t TopDocuments::ExtractTo(span<Document> output) {
+    INSTRUMENT_PHASE(SORT);
+    sort_heap(heap_.begin(), heap_.end(), IsBetter);
+    const size_t count = min(heap_.size(), output.size());
+    copy_n(heap_.begin(), count, output.begin());
+    heap_.clear();
+    return count;
+}
+
+bool TopDocuments::IsBetter(const Document& lhs, const Document& rhs) {
+    const double lhs_bucket = GetRelevanceBucket(lhs.relevance);
+    const double rhs_bucket = GetRelevanceBucket(rhs.relevance);
+    if (lhs_bucket != rhs_bucket) {
+        return lhs_bucket > rhs_bucket;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+double TopDocuments::GetRelevanceBucket(double relevance) {
+    return floor(relevance / RELEVANCE_EPSILON);
+}
+
+RelevanceThreshold::RelevanceThreshold(size_t count)
+    : count_(count)
+    , threshold_(count == 0 ? numeric_limits<double>::infinity() : -numeric_limits<double>::infinity()) {
+}
+
+void RelevanceThreshold::Offer(double relevance) {
+    if (heap_.size() < count_) {
+        heap_.push_back(relevance);
+        push_heap(heap_.begin(), heap_.end(), greater<>());
+        if (heap_.size() == count_) {
+            threshold_ = heap_.front();
+        }
+    }
+    else if (count_ > 0 && relevance > heap_.front()) {
+        pop_heap(heap_.begin(), heap_.end(), greater<>());
+        heap_.back() = relevance;
+        push_heap(heap_.begin(), heap_.end(), greater<>());
+        threshold_ = heap_.front();
+    }
+}
+
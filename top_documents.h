@@ -0,0 +1,67 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Keeps the best `capacity` documents offered so far. The worst of them sits on
+// top of a heap, so each rejected document costs a single comparison.
+class TopDocuments {
+public:
+    // Width of the relevance buckets: documents in one bucket are ordered by rating, then by id
+    static constexpr double RELEVANCE_EPSILON = 1e-6;
+
+    // With after set, only documents worse than it are kept, for the pages past it
+    explicit TopDocuments(size_t capacity, const std::optional<Document>& after = std::nullopt);
+
+    // Whether the document is worse than after, so that Add may keep it
+    bool Admits(const Document& document) const {
+        return !after_ || IsBetter(*after_, document);
+    }
+
+    void Add(const Document& document);
+
+    // Returns the kept documents, best first
+    std::vector<Document> Extract();
+
+    // Same order, written to output; returns how many documents were written
+    size_t ExtractTo(std::span<Document> output);
+
+    // Higher relevance bucket wins, then higher rating, then lower id. A strict weak order, so the
+    // documents kept don't depend on the order they are offered in, and the documents worse than
+    // a page's last one are exactly those ranked after it
+    static bool IsBetter(const Document& lhs, const Document& rhs);
+
+private:
+    // Comparing the difference of two relevances to the epsilon isn't transitive; comparing
+    // the buckets they fall in is
+    static double GetRelevanceBucket(double relevance);
+
+    size_t capacity_;
+    std::optional<Document> after_;
+    std::vector<Document> heap_;
+};
+
+// The count-th highest of the relevances offered so far. A document whose relevance stays
+// below it by more than RELEVANCE_EPSILON falls in a lower bucket than count others, so it is
+// worse than them whatever their ratings and can't make the top count documents
+class RelevanceThreshold {
+public:
+    explicit RelevanceThreshold(size_t count);
+
+    void Offer(double relevance);
+
+    // -infinity until count relevances were offered, +infinity for count 0
+    double Get() const noexcept {
+        return threshold_;
+    }
+
+private:
+    size_t count_;
+    // Min-heap of the count highest relevances
+    std::vector<double> heap_;
+    double threshold_;
+};